@@ -0,0 +1,7 @@
+# Micro-benchmarks for the core; not needed by the app.
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    graph_bench.pro \
+    layoutkernel_bench.pro \
+    lookup_bench.pro
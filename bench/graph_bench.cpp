@@ -0,0 +1,225 @@
+// Times the graph operations at sizes from 10 to 1M cities, to catch
+// performance regressions:
+//   wasalney_bench [--sizes 10,1000,...] [--layout-max N] [--json FILE]
+// Prints one TSV row per operation and size, with median and p99 latency
+// and throughput, and writes the same rows as JSON so runs can be diffed.
+// Layouts are slow, so they are only timed up to --layout-max cities
+// (default 100000).
+#include "filehandler.hpp"
+#include "graphlayout.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+volatile size_t keep; // results go here so the timed calls are not optimized away
+
+struct Result {
+    string op;
+    int cities = 0;
+    size_t samples = 0;
+    double medianMicros = 0, p99Micros = 0, meanMicros = 0;
+    double opsPerSecond = 0;
+};
+
+double micros(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+string cityName(int i)
+{
+    return "c" + to_string(i);
+}
+
+// Square grid, like a street map, with a few long shortcuts: about 2 edges
+// per city, times proportional to distance with some noise.
+Graph makeGraph(int cities, mt19937& random)
+{
+    Graph g;
+    int side = max(2, (int)ceil(sqrt((double)cities)));
+    g.reserveCities(cities);
+    for (int i = 0; i < cities; i++) g.addCityId(cityName(i));
+    uniform_real_distribution<double> length(5.0, 15.0), speed(40.0, 120.0);
+    auto connect = [&](int u, int v) {
+        double d = length(random);
+        g.addEdgeById(u, v, d, d / speed(random));
+    };
+    for (int id = 0; id < cities; id++) {
+        if ((id + 1) % side && id + 1 < cities) connect(id, id + 1);
+        if (id + side < cities) connect(id, id + side);
+    }
+    for (int i = 0; i < cities / 50; i++) connect(random() % cities, random() % cities);
+    return g;
+}
+
+// Runs op samples times, timing each call on its own.
+Result measure(const string& name, int cities, size_t samples, const function<void(size_t)>& op)
+{
+    vector<double> times(samples);
+    auto total = chrono::steady_clock::now();
+    for (size_t i = 0; i < samples; i++) {
+        auto start = chrono::steady_clock::now();
+        op(i);
+        times[i] = micros(start);
+    }
+    double elapsed = micros(total);
+    sort(times.begin(), times.end());
+    Result r;
+    r.op = name;
+    r.cities = cities;
+    r.samples = samples;
+    r.medianMicros = times[samples / 2];
+    r.p99Micros = times[min(samples - 1, samples * 99 / 100)];
+    double sum = 0;
+    for (double t : times) sum += t;
+    r.meanMicros = sum / samples;
+    r.opsPerSecond = elapsed > 0 ? samples / (elapsed / 1e6) : 0;
+    printf("%s\t%d\t%zu\t%.2f\t%.2f\t%.2f\t%.1f\n", r.op.c_str(), r.cities, r.samples, r.medianMicros,
+           r.p99Micros, r.meanMicros, r.opsPerSecond);
+    fflush(stdout);
+    return r;
+}
+
+// Samples for an operation that costs about `work` steps: enough for a
+// stable p99 on cheap ones, a handful on whole graph ones.
+size_t samplesFor(double work)
+{
+    return (size_t)max(5.0, min(10000.0, 2e7 / max(1.0, work)));
+}
+
+void bench(int cities, int layoutMax, const string& tempDir, vector<Result>& results)
+{
+    mt19937 random(cities);
+    Graph g;
+    results.push_back(measure("build", cities, 1, [&](size_t) { g = makeGraph(cities, random); }));
+
+    auto randomCity = [&]() { return cityName(random() % cities); };
+
+    // Edits go to copies, which share storage until written, so every size
+    // starts from the same graph.
+    {
+        Graph copy = g;
+        size_t n = samplesFor(1);
+        vector<pair<string, string>> pairs;
+        for (size_t i = 0; i < n; i++) pairs.push_back({randomCity(), randomCity()});
+        results.push_back(measure("addEdge", cities, n, [&](size_t i) {
+            copy.addEdge(pairs[i].first, pairs[i].second, 10.0, 0.1);
+        }));
+    }
+    {
+        Graph copy = g;
+        size_t n = min<size_t>(samplesFor(1), cities / 2 + 1);
+        vector<string> names;
+        for (size_t i = 0; i < n; i++) names.push_back(randomCity());
+        results.push_back(measure("deleteCity", cities, n, [&](size_t i) { copy.deleteCity(names[i]); }));
+    }
+
+    const size_t walks = samplesFor(cities);
+    vector<string> starts, ends;
+    for (size_t i = 0; i < walks; i++) {
+        starts.push_back(randomCity());
+        ends.push_back(randomCity());
+    }
+    results.push_back(measure("BFS", cities, walks, [&](size_t i) { keep = g.BFS(starts[i]).size(); }));
+    results.push_back(measure("DFS", cities, walks, [&](size_t i) { keep = g.DFS(starts[i]).size(); }));
+    // Random pairs settle about half the graph on average.
+    results.push_back(measure("DijkstraDistance", cities, walks, [&](size_t i) {
+        keep = g.DijkstraDistance(starts[i], ends[i]).path.size();
+    }));
+    results.push_back(measure("DijkstraTime", cities, walks, [&](size_t i) {
+        keep = g.DijkstraTime(starts[i], ends[i]).path.size();
+    }));
+
+    // Files: every sample writes or reads the whole map.
+    {
+        g.name = "Bench";
+        vector<shared_ptr<Graph>> graphs{make_shared<Graph>(g)};
+        string path = tempDir + "/wasalney_bench_" + to_string(cities) + ".txt";
+        size_t n = max<size_t>(3, min<size_t>(50, samplesFor(cities * 20.0)));
+        Filehandler files;
+        results.push_back(measure("save", cities, n, [&](size_t) { files.SaveInFile(path, graphs); }));
+        results.push_back(measure("load", cities, n, [&](size_t) {
+            vector<shared_ptr<Graph>> loaded;
+            files.ReadGraphFromFile(path, loaded);
+            keep = loaded.size();
+        }));
+        remove(path.c_str());
+    }
+
+    if (cities <= layoutMax) {
+        size_t n = max<size_t>(3, min<size_t>(20, samplesFor(cities * 200.0)));
+        results.push_back(measure("layout", cities, n, [&](size_t) {
+            GraphLayout layout(g, LayoutOptions());
+            layout.run();
+            keep = layout.iterationsDone();
+        }));
+    }
+}
+
+bool writeJson(const string& path, const vector<Result>& results)
+{
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) return false;
+    fprintf(out, "{\"benchmark\":\"wasalney_bench\",\"results\":[");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(out, "%s\n{\"op\":\"%s\",\"cities\":%d,\"samples\":%zu,\"median_us\":%.3f,\"p99_us\":%.3f,"
+                     "\"mean_us\":%.3f,\"ops_per_s\":%.3f}",
+                i ? "," : "", r.op.c_str(), r.cities, r.samples, r.medianMicros, r.p99Micros, r.meanMicros,
+                r.opsPerSecond);
+    }
+    fprintf(out, "\n]}\n");
+    return fclose(out) == 0;
+}
+
+vector<int> parseSizes(const string& text)
+{
+    vector<int> sizes;
+    for (size_t start = 0; start < text.size();) {
+        size_t comma = text.find(',', start);
+        if (comma == string::npos) comma = text.size();
+        int n = atoi(text.substr(start, comma - start).c_str());
+        if (n >= 2) sizes.push_back(n);
+        start = comma + 1;
+    }
+    return sizes;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> sizes{10, 100, 1000, 10000, 100000, 1000000};
+    int layoutMax = 100000;
+    string jsonFile = "wasalney_bench.json";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 < argc && arg == "--sizes") sizes = parseSizes(argv[++i]);
+        else if (i + 1 < argc && arg == "--layout-max") layoutMax = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--json") jsonFile = argv[++i];
+        else {
+            fprintf(stderr, "Usage: wasalney_bench [--sizes 10,1000,...] [--layout-max N] [--json FILE]\n");
+            return 2;
+        }
+    }
+
+    string tempDir = filesystem::temp_directory_path().string();
+    vector<Result> results;
+    printf("op\tcities\tsamples\tmedian_us\tp99_us\tmean_us\tops_per_s\n");
+    for (int cities : sizes) bench(cities, layoutMax, tempDir, results);
+
+    if (!writeJson(jsonFile, results)) {
+        fprintf(stderr, "Failed to write %s\n", jsonFile.c_str());
+        return 1;
+    }
+    fprintf(stderr, "wrote %s\n", jsonFile.c_str());
+    return 0;
+}
@@ -0,0 +1,10 @@
+# Times the graph operations across sizes and writes JSON; see graph_bench.cpp.
+TEMPLATE = app
+TARGET = wasalney_bench
+CONFIG += console c++20
+CONFIG -= qt app_bundle
+
+include(../core/link_core.pri)
+
+SOURCES += \
+    graph_bench.cpp
@@ -0,0 +1,99 @@
+// Times the layout inner loops with every kernel this CPU can run, against
+// the scalar loop they replaced:
+//   wasalney_bench_layout [cities]
+// Prints one TSV row per kernel and loop, with the speedup over scalar.
+#include "graphlayout.hpp"
+#include "layoutkernel.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+using namespace std;
+
+namespace {
+volatile float keep; // results go here so the timed loops are not optimized away
+
+double seconds(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Square grid with some shortcuts, about 2 edges per city.
+Graph makeGraph(int cities)
+{
+    Graph g;
+    int side = max(2, (int)sqrt((double)cities));
+    for (int i = 0; i < side * side; i++) g.addCityId("c" + to_string(i));
+    mt19937 random(7);
+    uniform_real_distribution<double> length(5.0, 15.0);
+    for (int i = 0; i < side; i++) {
+        for (int j = 0; j < side; j++) {
+            int id = i * side + j;
+            if (j + 1 < side) g.addEdgeById(id, id + 1, length(random), 1.0);
+            if (i + 1 < side) g.addEdgeById(id, id + side, length(random), 1.0);
+        }
+    }
+    return g;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    const int cities = argc > 1 ? atoi(argv[1]) : 20000;
+    const vector<const LayoutKernel*> kernels = LayoutKernel::Available();
+    printf("loop\tkernel\tseconds\tns_per_item\tspeedup\n");
+
+    // Leaf sums: every body against blocks of LeafBodies-sized runs, the
+    // shape of the Barnes-Hut leaves.
+    {
+        const int bodies = 4096, rounds = 200;
+        vector<float, AlignedAllocator<float>> xs(bodies), ys(bodies);
+        mt19937 random(1);
+        uniform_real_distribution<float> coord(0.0f, 800.0f);
+        for (int i = 0; i < bodies; i++) {
+            xs[i] = coord(random);
+            ys[i] = coord(random);
+        }
+        double scalar = 0;
+        for (const LayoutKernel* kernel : kernels) {
+            float sink = 0;
+            auto start = chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r++) {
+                for (int i = 0; i < bodies; i += 8) {
+                    float ax = 0, ay = 0;
+                    kernel->repel(xs[i], ys[i], xs.data(), ys.data(), bodies, 10000.0f, ax, ay);
+                    sink += ax + ay;
+                }
+            }
+            double elapsed = seconds(start);
+            if (kernel == kernels[0]) scalar = elapsed;
+            double pairs = double(rounds) * (bodies / 8) * bodies;
+            printf("repel\t%s\t%.4f\t%.3f\t%.2f\n", kernel->name, elapsed, elapsed * 1e9 / pairs,
+                   scalar / elapsed);
+            keep = sink;
+        }
+    }
+
+    // Whole layouts, so the speedup includes the tree walk the kernels do
+    // not touch.
+    Graph g = makeGraph(cities);
+    for (bool multilevel : {false, true}) {
+        double scalar = 0;
+        for (const LayoutKernel* kernel : kernels) {
+            LayoutOptions options;
+            options.kernel = kernel;
+            options.multilevel = multilevel;
+            options.multilevelMinCities = 0;
+            options.iterations = multilevel ? options.iterations : 30;
+            auto start = chrono::steady_clock::now();
+            GraphLayout layout(g, options);
+            layout.run();
+            double elapsed = seconds(start);
+            if (kernel == kernels[0]) scalar = elapsed;
+            printf("%s\t%s\t%.4f\t%.1f\t%.2f\n", multilevel ? "layout_multilevel" : "layout_30_iterations",
+                   kernel->name, elapsed, elapsed * 1e9 / cities, scalar / elapsed);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+# Times the layout kernels against the scalar loop; see layoutkernel_bench.cpp.
+TEMPLATE = app
+TARGET = wasalney_bench_layout
+CONFIG += console c++20
+CONFIG -= qt app_bundle
+
+include(../core/link_core.pri)
+
+SOURCES += \
+    layoutkernel_bench.cpp
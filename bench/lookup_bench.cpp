@@ -0,0 +1,109 @@
+// Counts heap allocations and time per city lookup, passing names the way
+// callers used to (a std::string built for each call) and as string_view:
+//   wasalney_bench_lookup [cities]
+// Prints one TSV row per query. Names are longer than the small string
+// buffer, as real city names often are, so a temporary string allocates.
+#include "graph.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+using namespace std;
+
+namespace {
+atomic<uint64_t> allocations{0};
+volatile int keep; // results go here so the timed loops are not optimized away
+}
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+double seconds(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+string cityName(int i)
+{
+    char buf[32];
+    snprintf(buf, sizeof buf, "governorate-city-%06d", i);
+    return buf;
+}
+
+// Runs query once per name in queries and prints allocations and
+// nanoseconds per call.
+template <typename Query>
+void measure(const char* query, const char* passing, const vector<string>& queries, Query run)
+{
+    int sink = 0;
+    uint64_t before = allocations.load();
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < queries.size(); i++) {
+        sink += run(queries[i].c_str(), queries[(i * 7 + 3) % queries.size()].c_str());
+    }
+    double elapsed = seconds(start);
+    uint64_t count = allocations.load() - before;
+    printf("%s\t%s\t%.2f\t%.1f\n", query, passing, double(count) / queries.size(), elapsed * 1e9 / queries.size());
+    keep = sink;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    const int cities = argc > 1 ? max(2, atoi(argv[1])) : 100000;
+    Graph g;
+    g.reserveCities(cities);
+    for (int i = 0; i < cities; i++) g.addCityId(cityName(i));
+    mt19937 random(3);
+    for (int i = 1; i < cities; i++) {
+        g.addEdgeById(i, random() % i, 1.0 + random() % 100, 1.0);
+        g.addEdgeById(i, random() % cities, 1.0 + random() % 100, 1.0);
+    }
+
+    // Names arrive as C strings, as from a file buffer or a widget's UTF-8.
+    vector<string> queries;
+    for (int i = 0; i < 200000; i++) {
+        int id = random() % (cities + cities / 10); // some misses
+        queries.push_back(id < cities ? cityName(id) : cityName(id) + "?");
+    }
+
+    printf("query\tpassing\tallocs_per_query\tns_per_query\n");
+    measure("containsCity", "string", queries, [&](const char* a, const char*) {
+        return (int)g.containsCity(string(a));
+    });
+    measure("containsCity", "string_view", queries, [&](const char* a, const char*) {
+        return (int)g.containsCity(string_view(a));
+    });
+    measure("containsEdge", "string", queries, [&](const char* a, const char* b) {
+        return (int)g.containsEdge(string(a), string(b));
+    });
+    measure("containsEdge", "string_view", queries, [&](const char* a, const char* b) {
+        return (int)g.containsEdge(string_view(a), string_view(b));
+    });
+    // Adds the edges first, so the timed calls only update them.
+    for (size_t i = 0; i < queries.size(); i++) {
+        const string& b = queries[(i * 7 + 3) % queries.size()];
+        if (g.containsCity(queries[i]) && g.containsCity(b)) g.addEdge(queries[i], b, 1.0, 1.0);
+    }
+    measure("addEdge_update", "string", queries, [&](const char* a, const char* b) {
+        if (!g.containsCity(string(a)) || !g.containsCity(string(b))) return 0;
+        g.addEdge(string(a), string(b), 1.0, 1.0);
+        return 1;
+    });
+    measure("addEdge_update", "string_view", queries, [&](const char* a, const char* b) {
+        if (!g.containsCity(string_view(a)) || !g.containsCity(string_view(b))) return 0;
+        g.addEdge(string_view(a), string_view(b), 1.0, 1.0);
+        return 1;
+    });
+    return 0;
+}
@@ -0,0 +1,10 @@
+# Counts allocations per city lookup; see lookup_bench.cpp.
+TEMPLATE = app
+TARGET = wasalney_bench_lookup
+CONFIG += console c++20
+CONFIG -= qt app_bundle
+
+include(../core/link_core.pri)
+
+SOURCES += \
+    lookup_bench.cpp
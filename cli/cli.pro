@@ -0,0 +1,16 @@
+# wasalney_cli: batch routing queries against a map file, no GUI needed.
+TEMPLATE = app
+TARGET = wasalney_cli
+CONFIG += console c++20
+CONFIG -= qt app_bundle
+
+include(../core/link_core.pri)
+
+SOURCES += main.cpp
+
+# The query server is written against POSIX sockets; main.cpp leaves out
+# --port and --socket elsewhere.
+unix {
+    SOURCES += queryserver.cpp
+    HEADERS += queryserver.hpp
+}
@@ -0,0 +1,331 @@
+// wasalney_cli: answers batches of routing queries without the GUI.
+//
+//   wasalney_cli [options] <map file>
+//
+// Each input line is "<source> <destination> <distance|time>". Each output
+// line is tab separated: source, destination, metric, cost (or "unreachable"
+// / "error") and the path joined with "-->". Throughput and latency
+// statistics go to stderr when the input is exhausted. --stats writes
+// histograms of the per query counters (see querystats.hpp) to a file.
+// --trace (or $WASALNEY_TRACE) writes a Chrome trace of the run at exit.
+// Nothing is written next to the map file unless --write-index lets the tool
+// save the sidecar indexes it rebuilds, as the GUI does.
+//
+// With --port or --socket it instead serves JSON requests until interrupted;
+// see queryserver.hpp for the protocol. The server uses POSIX sockets, so
+// Windows builds leave it out. --layout-quality compares the single level and
+// multilevel layouts of the graph.
+#include "graphlayout.hpp"
+#include "program.hpp"
+#ifndef _WIN32
+#include "queryserver.hpp" // POSIX sockets only
+#endif
+#include "tracer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+struct Query {
+    string source, destination, metric;
+    bool byTime = false;
+    bool valid = false;
+};
+
+struct Answer {
+    Graph::PathResult result;
+    double micros = 0;
+};
+
+// Log scaled latency buckets (8 per doubling, from 0.1 us), so statistics
+// over an unbounded query stream take constant memory.
+struct LatencyHistogram {
+    static const int BUCKETS = 256;
+    size_t buckets[BUCKETS] = {};
+    size_t count = 0;
+    double sum = 0, max = 0;
+
+    void add(double micros) {
+        int b = micros <= 0.1 ? 0 : std::min(BUCKETS - 1, int(8 * log2(micros / 0.1)) + 1);
+        buckets[b]++;
+        count++;
+        sum += micros;
+        max = std::max(max, micros);
+    }
+    // Upper edge of the bucket holding the p-th fraction of samples.
+    double percentile(double p) const {
+        size_t rank = size_t(p * count), seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > rank) return std::min(max, 0.1 * exp2(b / 8.0));
+        }
+        return max;
+    }
+};
+
+void printUsage()
+{
+    cerr << "Usage: wasalney_cli [options] <map file>\n"
+            "  -g, --graph NAME     graph to query (default: the first one)\n"
+            "  -q, --queries FILE   read queries from FILE instead of stdin\n"
+            "  -o, --output FILE    write results to FILE instead of stdout\n"
+            "  -j, --threads N      worker threads (default: all cores)\n"
+            "      --stats FILE     write histograms of the search counters to FILE\n"
+            "      --trace FILE     write a Chrome trace of the run to FILE\n"
+            "  -l, --list           list the graphs in the map file and exit\n"
+            "      --write-index    save rebuilt sidecar indexes next to the map file\n"
+#ifndef _WIN32
+            "  -p, --port N         serve JSON requests on 127.0.0.1:N\n"
+            "  -s, --socket PATH    serve JSON requests on a Unix socket\n"
+#endif
+            "      --layout-quality time and compare the layout modes on the graph\n"
+            "Query lines: <source> <destination> <distance|time>\n";
+}
+
+bool parseQuery(const string& line, Query& q)
+{
+    istringstream in(line);
+    if (!(in >> q.source >> q.destination >> q.metric)) return false;
+    if (q.metric == "distance" || q.metric == "d") q.byTime = false;
+    else if (q.metric == "time" || q.metric == "t") q.byTime = true;
+    else return false;
+    return true;
+}
+
+// Answers queries[0, count) on the pool, one query per chunk so slow queries
+// do not hold up a whole range; results keep the input order.
+void answerBatch(TaskPool& pool, const Graph& g, const vector<Query>& queries, size_t count,
+                 vector<Answer>& answers)
+{
+    pool.parallelFor(0, (int)count, [&](int from, int to) {
+        for (int i = from; i < to; i++) {
+            const Query& q = queries[i];
+            if (!q.valid) continue;
+            auto start = chrono::steady_clock::now();
+            answers[i].result = q.byTime ? g.DijkstraTime(q.source, q.destination)
+                                         : g.DijkstraDistance(q.source, q.destination);
+            answers[i].micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        }
+    }, TaskPool::Interactive, CancelToken(), 1);
+}
+
+// Edge length variance is relative to the mean edge length, so layouts of
+// different sizes compare; the crossing rate is over sampled edge pairs.
+void printLayoutQuality(const Graph& g)
+{
+    printf("mode\tcities\tseconds\tedge_length_variance\tcrossing_rate\tpairs_sampled\n");
+    for (bool multilevel : {false, true}) {
+        LayoutOptions options;
+        options.multilevel = multilevel;
+        options.multilevelMinCities = 0;
+        auto start = chrono::steady_clock::now();
+        GraphLayout layout(g, options);
+        layout.run();
+        layout.fitToView();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        LayoutQuality quality = GraphLayout::Measure(g, layout.x, layout.y);
+        printf("%s\t%d\t%.3f\t%.4f\t%.6f\t%lld\n", multilevel ? "multilevel" : "single",
+               g.numberOfCities, seconds, quality.edgeLengthVariance, quality.crossingRate(),
+               quality.crossingPairs);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    string mapFile, graphName, queryFile, outputFile, statsFile;
+#ifndef _WIN32
+    string socketPath;
+    int port = 0;
+#endif
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    bool list = false, layoutQuality = false, writeIndexes = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << "Missing value for " << arg << "\n";
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "-g" || arg == "--graph") graphName = value();
+        else if (arg == "-q" || arg == "--queries") queryFile = value();
+        else if (arg == "-o" || arg == "--output") outputFile = value();
+        else if (arg == "-j" || arg == "--threads") threads = max(1, atoi(value().c_str()));
+        else if (arg == "--stats") statsFile = value();
+        else if (arg == "--trace") Tracer::Start(value());
+        else if (arg == "-l" || arg == "--list") list = true;
+        else if (arg == "--write-index") writeIndexes = true;
+#ifndef _WIN32
+        else if (arg == "-p" || arg == "--port") port = atoi(value().c_str());
+        else if (arg == "-s" || arg == "--socket") socketPath = value();
+#endif
+        else if (arg == "--layout-quality") layoutQuality = true;
+        else if (arg == "-h" || arg == "--help") { printUsage(); return 0; }
+        else if (!arg.empty() && arg[0] == '-') { printUsage(); return 2; }
+        else mapFile = arg;
+    }
+    if (mapFile.empty()) {
+        printUsage();
+        return 2;
+    }
+    if (!Tracer::Enabled()) Tracer::StartFromEnvironment();
+    if (!statsFile.empty() && !QueryStats::ENABLED) {
+        cerr << "--stats needs a build with query counters (qmake CONFIG+=query_stats)\n";
+        return 2;
+    }
+
+    auto loadStart = chrono::steady_clock::now();
+    Program program(mapFile, threads, writeIndexes);
+    if (!program.f.lastError.empty()) {
+        cerr << program.f.lastError << "\n";
+        return 1;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+
+    if (list) {
+        for (const auto& g : program.graphs) {
+            cout << g->name << "\t" << g->numberOfCities << " cities\n";
+        }
+        return 0;
+    }
+
+#ifndef _WIN32
+    if (port > 0 || !socketPath.empty()) {
+        QueryServer server(program);
+        if (!(socketPath.empty() ? server.ListenTcp(port) : server.ListenUnix(socketPath))) {
+            cerr << server.lastError << "\n";
+            return 1;
+        }
+        cerr << "serving " << program.graphs.size() << " graphs on "
+             << (socketPath.empty() ? "127.0.0.1:" + to_string(port) : socketPath)
+             << " with " << threads << " threads\n";
+        int status = server.Run();
+        if (status != 0) cerr << server.lastError << "\n";
+        return status;
+    }
+#endif
+
+    shared_ptr<Graph> graph = graphName.empty()
+        ? (program.graphs.empty() ? nullptr : program.graphs.front())
+        : program.getGraphByName(graphName);
+    if (!graph) {
+        cerr << "Graph not found: " << (graphName.empty() ? mapFile : graphName) << "\n";
+        return 1;
+    }
+
+    if (layoutQuality) {
+        printLayoutQuality(*graph);
+        return 0;
+    }
+
+    ifstream queryStream;
+    if (!queryFile.empty()) {
+        queryStream.open(queryFile);
+        if (!queryStream) {
+            cerr << "Failed to open queries: " << queryFile << "\n";
+            return 1;
+        }
+    }
+    istream& in = queryFile.empty() ? cin : queryStream;
+
+    ofstream outputStream;
+    if (!outputFile.empty()) {
+        outputStream.open(outputFile);
+        if (!outputStream) {
+            cerr << "Failed to open output: " << outputFile << "\n";
+            return 1;
+        }
+    }
+    ostream& out = outputFile.empty() ? cout : outputStream;
+
+    // Queries are read and answered in fixed size batches so arbitrarily long
+    // input streams run in bounded memory.
+    const size_t BATCH = 4096;
+    vector<Query> queries(BATCH);
+    vector<Answer> answers(BATCH);
+    LatencyHistogram latency;
+    QueryStatsHistograms searchStats;
+    size_t total = 0, errors = 0, unreachable = 0;
+    auto runStart = chrono::steady_clock::now();
+
+    string line;
+    bool more = true;
+    while (more) {
+        size_t count = 0;
+        while (count < BATCH && (more = static_cast<bool>(getline(in, line)))) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.find_first_not_of(" \t") == string::npos) continue;
+            Query& q = queries[count];
+            q = Query();
+            q.valid = parseQuery(line, q);
+            if (!q.valid) q.source = line;
+            answers[count] = Answer();
+            count++;
+        }
+        if (count == 0) break;
+
+        answerBatch(program.pool, *graph, queries, count, answers);
+
+        for (size_t i = 0; i < count; i++) {
+            const Query& q = queries[i];
+            total++;
+            if (!q.valid) {
+                errors++;
+                out << q.source << "\t\t\terror\t\n";
+                continue;
+            }
+            const Graph::PathResult& r = answers[i].result;
+            latency.add(answers[i].micros);
+            searchStats.add(r.stats);
+            out << q.source << '\t' << q.destination << '\t' << q.metric << '\t';
+            if (r.path.empty()) {
+                unreachable++;
+                out << "unreachable\t\n";
+                continue;
+            }
+            out << r.distanceOrTime << '\t';
+            for (size_t k = 0; k < r.path.size(); k++) {
+                if (k) out << "-->";
+                out << r.path[k];
+            }
+            out << '\n';
+        }
+    }
+    out.flush();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+
+    fprintf(stderr,
+            "graph %s: %d cities, loaded in %.3f s\n"
+            "%zu queries (%zu unreachable, %zu invalid) on %u threads in %.3f s: %.1f queries/s\n"
+            "latency us: mean %.1f  p50 %.1f  p99 %.1f  max %.1f\n",
+            graph->name.c_str(), graph->numberOfCities, loadSeconds,
+            total, unreachable, errors, threads, seconds, seconds > 0 ? total / seconds : 0.0,
+            latency.count ? latency.sum / latency.count : 0.0,
+            latency.percentile(0.50), latency.percentile(0.99), latency.max);
+
+    if (!statsFile.empty()) {
+        FILE* stats = fopen(statsFile.c_str(), "w");
+        if (!stats) {
+            cerr << "Failed to open stats: " << statsFile << "\n";
+            return 1;
+        }
+        searchStats.write(stats);
+        fclose(stats);
+    }
+    return 0;
+}
@@ -0,0 +1,722 @@
+#include "queryserver.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// ---- Minimal JSON, enough for the request format ----
+
+struct Json {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0;
+    string text; // for a Number, the token as it was written
+    vector<Json> items;
+    vector<pair<string, Json>> members;
+
+    const Json* get(const string& key) const {
+        for (const auto& [k, v] : members) {
+            if (k == key) return &v;
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const string& s) : p(s.data()), e(s.data() + s.size()) {}
+
+    bool parse(Json& out) {
+        if (!value(out, 0)) return false;
+        skip();
+        return p == e;
+    }
+
+private:
+    void skip() { while (p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p; }
+
+    bool literal(const char* word) {
+        size_t n = strlen(word);
+        if (size_t(e - p) < n || memcmp(p, word, n) != 0) return false;
+        p += n;
+        return true;
+    }
+
+    static void appendUtf8(string& out, unsigned cp) {
+        if (cp < 0x80) out += char(cp);
+        else if (cp < 0x800) { out += char(0xC0 | cp >> 6); out += char(0x80 | (cp & 0x3F)); }
+        else if (cp < 0x10000) { out += char(0xE0 | cp >> 12); out += char(0x80 | (cp >> 6 & 0x3F)); out += char(0x80 | (cp & 0x3F)); }
+        else { out += char(0xF0 | cp >> 18); out += char(0x80 | (cp >> 12 & 0x3F)); out += char(0x80 | (cp >> 6 & 0x3F)); out += char(0x80 | (cp & 0x3F)); }
+    }
+
+    bool hex4(unsigned& cp) {
+        if (e - p < 4) return false;
+        cp = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p++;
+            cp <<= 4;
+            if (c >= '0' && c <= '9') cp |= c - '0';
+            else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool str(string& out) {
+        if (p == e || *p != '"') return false;
+        ++p;
+        while (p < e && *p != '"') {
+            char c = *p++;
+            if (c != '\\') { out += c; continue; }
+            if (p == e) return false;
+            char esc = *p++;
+            switch (esc) {
+            case '"': case '\\': case '/': out += esc; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned cp;
+                if (!hex4(cp)) return false;
+                if (cp >= 0xD800 && cp < 0xDC00 && e - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    p += 2;
+                    unsigned low;
+                    if (!hex4(low)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default: return false;
+            }
+        }
+        if (p == e) return false;
+        ++p;
+        return true;
+    }
+
+    bool value(Json& out, int depth) {
+        if (depth > 16) return false;
+        skip();
+        if (p == e) return false;
+        if (*p == '"') { out.type = Json::String; return str(out.text); }
+        if (*p == '{') {
+            out.type = Json::Object;
+            ++p;
+            skip();
+            if (p < e && *p == '}') { ++p; return true; }
+            for (;;) {
+                skip();
+                string key;
+                if (!str(key)) return false;
+                skip();
+                if (p == e || *p++ != ':') return false;
+                out.members.emplace_back(std::move(key), Json());
+                if (!value(out.members.back().second, depth + 1)) return false;
+                skip();
+                if (p < e && *p == ',') { ++p; continue; }
+                if (p < e && *p == '}') { ++p; return true; }
+                return false;
+            }
+        }
+        if (*p == '[') {
+            out.type = Json::Array;
+            ++p;
+            skip();
+            if (p < e && *p == ']') { ++p; return true; }
+            for (;;) {
+                out.items.emplace_back();
+                if (!value(out.items.back(), depth + 1)) return false;
+                skip();
+                if (p < e && *p == ',') { ++p; continue; }
+                if (p < e && *p == ']') { ++p; return true; }
+                return false;
+            }
+        }
+        if (literal("true")) { out.type = Json::Bool; out.boolean = true; return true; }
+        if (literal("false")) { out.type = Json::Bool; return true; }
+        if (literal("null")) return true;
+        return number(out);
+    }
+
+    // JSON grammar only: strtod alone would also take nan, inf and hex.
+    bool number(Json& out) {
+        const char* start = p;
+        auto digits = [this]() {
+            const char* first = p;
+            while (p < e && *p >= '0' && *p <= '9') ++p;
+            return p > first;
+        };
+        if (p < e && *p == '-') ++p;
+        if (p < e && *p == '0') ++p;
+        else if (!digits()) return false;
+        if (p < e && *p == '.') {
+            ++p;
+            if (!digits()) return false;
+        }
+        if (p < e && (*p == 'e' || *p == 'E')) {
+            ++p;
+            if (p < e && (*p == '+' || *p == '-')) ++p;
+            if (!digits()) return false;
+        }
+        out.text.assign(start, p);
+        out.number = strtod(out.text.c_str(), nullptr);
+        out.type = Json::Number;
+        return isfinite(out.number);
+    }
+
+    const char* p;
+    const char* e;
+};
+
+void writeString(string& out, const string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof buf, "\\u%04x", c);
+                out += buf;
+            } else {
+                out += char(c);
+            }
+        }
+    }
+    out += '"';
+}
+
+void writeNumber(string& out, double value) {
+    if (!isfinite(value)) {
+        out += "null";
+        return;
+    }
+    // Shortest form that reads back as the same double.
+    char buf[32];
+    out.append(buf, to_chars(buf, buf + sizeof buf, value).ptr);
+}
+
+string textField(const Json& request, const char* key) {
+    const Json* v = request.get(key);
+    return v && v->type == Json::String ? v->text : string();
+}
+
+bool numberField(const Json& request, const char* key, double& value) {
+    const Json* v = request.get(key);
+    if (!v || v->type != Json::Number) return false;
+    value = v->number;
+    return true;
+}
+
+// Fails the request with a message; caught in Handle.
+struct RequestError {
+    string message;
+};
+
+int requireCity(const Graph& g, const Json& request, const char* key) {
+    string name = textField(request, key);
+    int id = g.cityId(name);
+    if (id < 0) throw RequestError{"Unknown city in \"" + string(key) + "\": " + name};
+    return id;
+}
+
+bool metricIsTime(const Json& request) {
+    string metric = textField(request, "metric");
+    if (metric.empty() || metric == "distance") return false;
+    if (metric == "time") return true;
+    throw RequestError{"metric must be \"distance\" or \"time\""};
+}
+
+const size_t MAX_LINE = 1 << 20;
+const size_t MAX_PENDING_OUTPUT = 16 << 20;
+const int MAX_PENDING_REQUESTS = 256; // per connection; later lines wait unread
+const size_t MAX_MATRIX_CELLS = 1000000;
+
+int signalPipe = -1;
+
+void onSignal(int) {
+    if (signalPipe >= 0) {
+        char c = 's';
+        ssize_t ignored = write(signalPipe, &c, 1);
+        (void)ignored;
+    }
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+} // namespace
+
+struct QueryServer::Connection {
+    int fd;
+    string in;             // event loop thread only
+    bool readClosed = false; // the client half-closed; event loop thread only
+    atomic<int> pending{0};  // requests on the pool whose answers are not in out yet
+    mutex outMutex;
+    string out;            // answers waiting to be written
+    atomic<bool> closed{false};
+};
+
+QueryServer::QueryServer(Program& program) : program(program)
+{
+    for (const auto& g : program.graphs) {
+        snapshots.push_back({g->name, g->snapshot()});
+    }
+    if (pipe(wakePipe) == 0) {
+        setNonBlocking(wakePipe[0]);
+        setNonBlocking(wakePipe[1]);
+    }
+}
+
+QueryServer::~QueryServer()
+{
+    {
+        unique_lock<mutex> lock(taskMutex);
+        tasksDone.wait(lock, [this]() { return running == 0; });
+    }
+    if (listenFd >= 0) close(listenFd);
+    if (!unixPath.empty()) unlink(unixPath.c_str());
+    for (int fd : wakePipe) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool QueryServer::ListenTcp(int port)
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (listenFd < 0 || ::bind(listenFd, (sockaddr*)&addr, sizeof addr) != 0 || listen(listenFd, 128) != 0) {
+        lastError = "Cannot listen on 127.0.0.1:" + to_string(port) + ": " + strerror(errno);
+        return false;
+    }
+    setNonBlocking(listenFd);
+    return true;
+}
+
+bool QueryServer::ListenUnix(const string& path)
+{
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        lastError = "Socket path too long: " + path;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || ::bind(listenFd, (sockaddr*)&addr, sizeof addr) != 0 || listen(listenFd, 128) != 0) {
+        lastError = "Cannot listen on " + path + ": " + strerror(errno);
+        return false;
+    }
+    unixPath = path;
+    setNonBlocking(listenFd);
+    return true;
+}
+
+void QueryServer::Stop()
+{
+    stopping = true;
+    wake();
+}
+
+void QueryServer::wake()
+{
+    char c = 'w';
+    ssize_t ignored = write(wakePipe[1], &c, 1);
+    (void)ignored;
+}
+
+void QueryServer::submit(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(taskMutex);
+        running++;
+    }
+    program.pool.submit([this, task = std::move(task)]() {
+        task();
+        lock_guard<mutex> lock(taskMutex);
+        if (--running == 0) tasksDone.notify_all();
+    }, TaskPool::Interactive);
+}
+
+int QueryServer::Run()
+{
+    if (listenFd < 0) {
+        lastError = "Not listening";
+        return 1;
+    }
+    signalPipe = wakePipe[1];
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    map<int, shared_ptr<Connection>> connections;
+    vector<pollfd> fds;
+    vector<shared_ptr<Connection>> polled;
+    char buffer[64 * 1024];
+
+    auto request = [this](const shared_ptr<Connection>& conn, string line) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) return;
+        conn->pending++;
+        submit([this, conn, line = std::move(line)]() {
+            string answer = Handle(line);
+            if (!conn->closed) {
+                lock_guard<mutex> lock(conn->outMutex);
+                conn->out += answer;
+                conn->out += '\n';
+            }
+            conn->pending--;
+            wake();
+        });
+    };
+    // Hands complete lines to the pool, up to MAX_PENDING_REQUESTS at a time;
+    // the rest wait in in, and the connection is not read until they fit.
+    auto takeLines = [&](const shared_ptr<Connection>& conn) {
+        size_t start = 0;
+        while (conn->pending < MAX_PENDING_REQUESTS) {
+            size_t nl = conn->in.find('\n', start);
+            if (nl == string::npos) {
+                // After a half-close the last line needs no newline.
+                if (conn->readClosed && start < conn->in.size()) {
+                    request(conn, conn->in.substr(start));
+                    start = conn->in.size();
+                }
+                break;
+            }
+            request(conn, conn->in.substr(start, nl - start));
+            start = nl + 1;
+        }
+        conn->in.erase(0, start);
+    };
+
+    while (!stopping) {
+        fds.assign({{listenFd, POLLIN, 0}, {wakePipe[0], POLLIN, 0}});
+        polled.assign(2, nullptr);
+        for (auto& [fd, conn] : connections) {
+            short events = 0;
+            {
+                lock_guard<mutex> lock(conn->outMutex);
+                if (!conn->out.empty()) events |= POLLOUT;
+                // Stop reading from clients that do not collect their answers.
+                if (!conn->readClosed && conn->out.size() < MAX_PENDING_OUTPUT
+                    && conn->pending < MAX_PENDING_REQUESTS)
+                    events |= POLLIN;
+            }
+            fds.push_back({fd, events, 0});
+            polled.push_back(conn);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            lastError = string("poll failed: ") + strerror(errno);
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            for (ssize_t n; (n = read(wakePipe[0], buffer, sizeof buffer)) > 0;) {
+                if (memchr(buffer, 's', n)) stopping = true;
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            for (int fd; (fd = accept(listenFd, nullptr, nullptr)) >= 0;) {
+                setNonBlocking(fd);
+                auto conn = make_shared<Connection>();
+                conn->fd = fd;
+                connections[fd] = conn;
+            }
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            auto& conn = polled[i];
+            bool drop = fds[i].revents & (POLLERR | POLLNVAL);
+            // Both directions are shut: nobody is left to read the answers.
+            if (conn->readClosed && (fds[i].revents & POLLHUP)) drop = true;
+            if (!drop && !conn->in.empty()) takeLines(conn); // lines held back earlier
+
+            if (!drop && !conn->readClosed && (fds[i].revents & (POLLIN | POLLHUP))) {
+                ssize_t n = read(conn->fd, buffer, sizeof buffer);
+                if (n > 0) {
+                    conn->in.append(buffer, n);
+                    takeLines(conn);
+                    size_t nl = conn->in.rfind('\n');
+                    if (conn->in.size() - (nl == string::npos ? 0 : nl + 1) > MAX_LINE) drop = true;
+                } else if (n == 0) {
+                    // The client may only have shut its writing side (nc -N):
+                    // answer what it sent, a last unterminated line included,
+                    // and close once everything is written.
+                    conn->readClosed = true;
+                    takeLines(conn);
+                } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    drop = true;
+                }
+            }
+
+            if (!drop && (fds[i].revents & POLLOUT)) {
+                lock_guard<mutex> lock(conn->outMutex);
+                ssize_t n = write(conn->fd, conn->out.data(), conn->out.size());
+                if (n > 0) conn->out.erase(0, n);
+                else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) drop = true;
+            }
+
+            // pending is read before out: a task fills out before it counts down.
+            if (!drop && conn->readClosed && conn->in.empty() && conn->pending == 0) {
+                lock_guard<mutex> lock(conn->outMutex);
+                drop = conn->out.empty();
+            }
+
+            if (drop) {
+                conn->closed = true;
+                close(conn->fd);
+                connections.erase(conn->fd);
+            }
+        }
+    }
+
+    for (auto& [fd, conn] : connections) {
+        conn->closed = true;
+        close(fd);
+    }
+    signalPipe = -1;
+    return lastError.empty() ? 0 : 1;
+}
+
+shared_ptr<const Graph> QueryServer::snapshot(const string& name, int& slot) const
+{
+    for (size_t i = 0; i < snapshots.size(); i++) {
+        if (name.empty() || snapshots[i].name == name) {
+            slot = (int)i;
+            return atomic_load(&snapshots[i].graph);
+        }
+    }
+    throw RequestError{"Unknown graph: " + name};
+}
+
+void QueryServer::publish(int slot, shared_ptr<const Graph> graph)
+{
+    atomic_store(&snapshots[slot].graph, std::move(graph));
+}
+
+string QueryServer::Handle(const string& requestLine)
+{
+    Json request;
+    string out = "{";
+    JsonParser parser(requestLine);
+    if (!parser.parse(request) || request.type != Json::Object) {
+        return "{\"ok\":false,\"error\":\"Invalid JSON request\"}";
+    }
+    if (const Json* id = request.get("id")) {
+        out += "\"id\":";
+        if (id->type == Json::String) writeString(out, id->text);
+        else if (id->type == Json::Number) out += id->text; // as sent, so big ids match
+        else out += "null";
+        out += ",";
+    }
+    const size_t head = out.size(); // an error drops what a failed op had written
+
+    try {
+        string op = textField(request, "op");
+        int slot = 0;
+
+        if (op == "graphs") {
+            out += "\"ok\":true,\"graphs\":[";
+            for (size_t i = 0; i < snapshots.size(); i++) {
+                auto g = atomic_load(&snapshots[i].graph);
+                if (i) out += ",";
+                out += "{\"name\":";
+                writeString(out, snapshots[i].name);
+                out += ",\"cities\":" + to_string(g->numberOfCities) + ",\"version\":" + to_string(g->version) + "}";
+            }
+            return out + "]}";
+        }
+
+        if (op == "route") {
+            auto g = snapshot(textField(request, "graph"), slot);
+            int from = requireCity(*g, request, "from"), to = requireCity(*g, request, "to");
+            bool byTime = metricIsTime(request);
+            auto result = byTime ? g->DijkstraTime(g->cityNames[from], g->cityNames[to])
+                                 : g->DijkstraDistance(g->cityNames[from], g->cityNames[to]);
+            out += "\"ok\":true,\"cost\":";
+            writeNumber(out, result.path.empty() ? numeric_limits<double>::infinity() : result.distanceOrTime);
+            out += ",\"path\":[";
+            for (size_t i = 0; i < result.path.size(); i++) {
+                if (i) out += ",";
+                writeString(out, result.path[i]);
+            }
+            return out + "]}";
+        }
+
+        if (op == "matrix") {
+            auto g = snapshot(textField(request, "graph"), slot);
+            bool byTime = metricIsTime(request);
+            const Json* sources = request.get("sources");
+            const Json* targets = request.get("targets");
+            if (!sources || !targets || sources->type != Json::Array || targets->type != Json::Array) {
+                throw RequestError{"matrix needs \"sources\" and \"targets\" arrays"};
+            }
+            if (sources->items.size() * targets->items.size() > MAX_MATRIX_CELLS) {
+                throw RequestError{"matrix too large"};
+            }
+            vector<int> targetIds;
+            for (const Json& t : targets->items) {
+                int id = g->cityId(t.text);
+                if (id < 0) throw RequestError{"Unknown city in \"targets\": " + t.text};
+                targetIds.push_back(id);
+            }
+            vector<int> sourceIds;
+            for (const Json& s : sources->items) {
+                int id = g->cityId(s.text);
+                if (id < 0) throw RequestError{"Unknown city in \"sources\": " + s.text};
+                sourceIds.push_back(id);
+            }
+            // One search per source, spread over the pool.
+            vector<vector<double>> rows(sourceIds.size());
+            program.pool.parallelFor(0, (int)sourceIds.size(), [&](int from, int to) {
+                for (int i = from; i < to; i++) {
+                    vector<double> costs = g->DijkstraFrom(sourceIds[i], byTime);
+                    for (int id : targetIds) rows[i].push_back(costs[id]);
+                }
+            }, TaskPool::Interactive, CancelToken(), 1);
+            out += "\"ok\":true,\"costs\":[";
+            for (size_t i = 0; i < rows.size(); i++) {
+                out += i ? ",[" : "[";
+                for (size_t j = 0; j < rows[i].size(); j++) {
+                    if (j) out += ",";
+                    writeNumber(out, rows[i][j]);
+                }
+                out += "]";
+            }
+            return out + "]}";
+        }
+
+        if (op == "isochrone") {
+            auto g = snapshot(textField(request, "graph"), slot);
+            int from = requireCity(*g, request, "from");
+            bool byTime = metricIsTime(request);
+            double limit;
+            if (!numberField(request, "limit", limit) || limit < 0) {
+                throw RequestError{"isochrone needs a non negative \"limit\""};
+            }
+            vector<double> costs = g->DijkstraFrom(from, byTime, limit);
+            vector<pair<double, int>> reached;
+            for (int id = 0; id < (int)costs.size(); id++) {
+                if (costs[id] <= limit) reached.push_back({costs[id], id});
+            }
+            sort(reached.begin(), reached.end());
+            out += "\"ok\":true,\"cities\":[";
+            for (size_t i = 0; i < reached.size(); i++) {
+                out += i ? ",{\"name\":" : "{\"name\":";
+                writeString(out, g->cityNames[reached[i].second]);
+                out += ",\"cost\":";
+                writeNumber(out, reached[i].first);
+                out += "}";
+            }
+            return out + "]}";
+        }
+
+        if (op == "bfs" || op == "dfs") {
+            auto g = snapshot(textField(request, "graph"), slot);
+            int from = requireCity(*g, request, "from");
+            vector<string> order = op == "bfs" ? g->BFS(g->cityNames[from]) : g->DFS(g->cityNames[from]);
+            out += "\"ok\":true,\"order\":[";
+            for (size_t i = 0; i < order.size(); i++) {
+                if (i) out += ",";
+                writeString(out, order[i]);
+            }
+            return out + "]}";
+        }
+
+        if (op == "add_city" || op == "delete_city" || op == "delete_cities" || op == "add_edge"
+            || op == "delete_edge") {
+            // Writers are serialised; readers keep using the snapshot they hold.
+            lock_guard<mutex> lock(writerMutex);
+            auto current = snapshot(textField(request, "graph"), slot);
+            auto next = make_shared<Graph>(*current);
+            if (op == "add_city") {
+                string name = textField(request, "name");
+                if (name.empty() || name.find_first_of(" \t\r\n") != string::npos) {
+                    throw RequestError{"\"name\" must be a non empty name without spaces"};
+                }
+                next->addCity(name);
+            } else if (op == "delete_city") {
+                requireCity(*next, request, "name");
+                next->deleteCity(textField(request, "name"));
+            } else if (op == "delete_cities") {
+                const Json* names = request.get("names");
+                if (!names || names->type != Json::Array) throw RequestError{"delete_cities needs a \"names\" array"};
+                vector<string> list;
+                for (const Json& n : names->items) {
+                    if (n.type != Json::String || next->cityId(n.text) < 0) {
+                        throw RequestError{"Unknown city in \"names\": " + n.text};
+                    }
+                    list.push_back(n.text);
+                }
+                next->deleteCities(list);
+            } else if (op == "add_edge") {
+                int from = requireCity(*next, request, "from"), to = requireCity(*next, request, "to");
+                double distance, time;
+                if (!numberField(request, "distance", distance) || !numberField(request, "time", time)) {
+                    throw RequestError{"add_edge needs numeric \"distance\" and \"time\""};
+                }
+                next->addEdgeById(from, to, distance, time);
+            } else {
+                int from = requireCity(*next, request, "from"), to = requireCity(*next, request, "to");
+                next->deleteEdge(next->cityNames[from], next->cityNames[to]);
+            }
+            uint64_t version = next->version;
+            publish(slot, std::move(next));
+            return out + "\"ok\":true,\"version\":" + to_string(version) + "}";
+        }
+
+        if (op == "save") {
+            lock_guard<mutex> lock(writerMutex);
+            vector<shared_ptr<Graph>> graphs;
+            for (const auto& s : snapshots) {
+                graphs.push_back(make_shared<Graph>(*atomic_load(&s.graph)));
+            }
+            if (!program.f.SaveInFile(program.mapFile, graphs)) throw RequestError{program.f.lastError};
+            return out + "\"ok\":true}";
+        }
+
+        throw RequestError{"Unknown op: " + op};
+    } catch (const RequestError& e) {
+        out.resize(head);
+        out += "\"ok\":false,\"error\":";
+        writeString(out, e.message);
+        return out + "}";
+    } catch (const exception& e) {
+        // Out of memory on a huge request, say: only this request fails.
+        out.resize(head);
+        out += "\"ok\":false,\"error\":";
+        writeString(out, string("Request failed: ") + e.what());
+        return out + "}";
+    }
+}
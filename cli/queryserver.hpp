@@ -0,0 +1,80 @@
+#ifndef QUERYSERVER_HPP
+#define QUERYSERVER_HPP
+#include "program.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Routing server speaking line delimited JSON on a loopback TCP port or a
+// Unix socket. One event loop thread owns every socket and hands complete
+// request lines to the program's task pool as interactive tasks.
+//
+// Queries run against an immutable snapshot of the graph. Edits copy the
+// current snapshot, change the copy and publish it with an atomic swap, so
+// queries already running keep their version and never wait on a writer.
+//
+// Requests carry an "op" and may carry an "id" (echoed back, since answers to
+// pipelined requests can come back out of order) and a "graph" name (default:
+// the first graph):
+//   {"op":"route","from":"A","to":"B","metric":"distance"}
+//   {"op":"matrix","sources":["A"],"targets":["B","C"],"metric":"time"}
+//   {"op":"isochrone","from":"A","limit":2.5,"metric":"time"}
+//   {"op":"bfs","from":"A"}        {"op":"dfs","from":"A"}
+//   {"op":"add_city","name":"X"}   {"op":"delete_city","name":"X"}
+//   {"op":"delete_cities","names":["X","Y"]}  (also renumbers city ids)
+//   {"op":"add_edge","from":"A","to":"X","distance":10,"time":0.2}
+//   {"op":"delete_edge","from":"A","to":"X"}
+//   {"op":"graphs"}                {"op":"save"}
+class QueryServer
+{
+public:
+    explicit QueryServer(Program& program);
+    ~QueryServer();
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    bool ListenTcp(int port); // binds 127.0.0.1 only
+    bool ListenUnix(const string& path);
+    // Serves until Stop() is called or the process gets SIGINT/SIGTERM.
+    int Run();
+    void Stop();
+
+    // Answers one request line; used by the pool tasks, and handy for tests.
+    string Handle(const string& requestLine);
+
+    string lastError;
+
+private:
+    struct Connection;
+    struct Snapshot {
+        string name;
+        shared_ptr<const Graph> graph; // atomic_load/atomic_store only
+    };
+
+    shared_ptr<const Graph> snapshot(const string& name, int& slot) const;
+    void publish(int slot, shared_ptr<const Graph> graph);
+    void submit(function<void()> task);
+    void wake();
+
+    Program& program;
+    vector<Snapshot> snapshots;
+    mutex writerMutex;
+
+    int listenFd = -1;
+    string unixPath;
+    int wakePipe[2] = {-1, -1};
+    atomic<bool> stopping{false};
+
+    // Requests handed to the pool and not yet answered; the destructor waits
+    // for them, since they use this server.
+    int running = 0;
+    mutex taskMutex;
+    condition_variable tasksDone;
+};
+
+#endif // QUERYSERVER_HPP
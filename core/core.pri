@@ -0,0 +1,42 @@
+# GUI-free core shared by the Qt app, the static library and the tools.
+# Nothing listed here may include Qt headers.
+
+INCLUDEPATH += $$PWD/../include
+
+# qmake CONFIG+=query_stats counts the work of every route query (querystats.hpp).
+query_stats: DEFINES += WASALNEY_QUERY_STATS
+
+SOURCES += \
+    $$PWD/../src/program.cpp \
+    $$PWD/../src/filehandler.cpp \
+    $$PWD/../src/graph.cpp \
+    $$PWD/../src/graphimporter.cpp \
+    $$PWD/../src/indexstore.cpp \
+    $$PWD/../src/graphlayout.cpp \
+    $$PWD/../src/layoutkernel.cpp \
+    $$PWD/../src/layoutworker.cpp \
+    $$PWD/../src/spatialindex.cpp \
+    $$PWD/../src/cityindex.cpp \
+    $$PWD/../src/taskpool.cpp \
+    $$PWD/../src/tracer.cpp \
+    $$PWD/../src/mapgenerator.cpp
+
+HEADERS += \
+    $$PWD/../include/program.hpp \
+    $$PWD/../include/filehandler.hpp \
+    $$PWD/../include/graph.hpp \
+    $$PWD/../include/stringhash.hpp \
+    $$PWD/../include/cowvector.hpp \
+    $$PWD/../include/generator.hpp \
+    $$PWD/../include/searchrecorder.hpp \
+    $$PWD/../include/querystats.hpp \
+    $$PWD/../include/graphimporter.hpp \
+    $$PWD/../include/indexstore.hpp \
+    $$PWD/../include/graphlayout.hpp \
+    $$PWD/../include/layoutkernel.hpp \
+    $$PWD/../include/layoutworker.hpp \
+    $$PWD/../include/spatialindex.hpp \
+    $$PWD/../include/cityindex.hpp \
+    $$PWD/../include/taskpool.hpp \
+    $$PWD/../include/tracer.hpp \
+    $$PWD/../include/mapgenerator.hpp
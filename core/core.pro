@@ -0,0 +1,7 @@
+# libwasalney_core: the routing core as a static library without Qt.
+TEMPLATE = lib
+TARGET = wasalney_core
+CONFIG += staticlib c++20
+CONFIG -= qt
+
+include(core.pri)
@@ -0,0 +1,16 @@
+# Links a tool against libwasalney_core built by core/core.pro.
+
+INCLUDEPATH += $$PWD/../include
+
+# Same switch as core.pri, so tools see the counters the library fills in.
+query_stats: DEFINES += WASALNEY_QUERY_STATS
+CORE_OUT = $$OUT_PWD/../core
+
+win32:CONFIG(release, debug|release): CORE_LIB_DIR = $$CORE_OUT/release
+else:win32:CONFIG(debug, debug|release): CORE_LIB_DIR = $$CORE_OUT/debug
+else: CORE_LIB_DIR = $$CORE_OUT
+
+LIBS += -L$$CORE_LIB_DIR -lwasalney_core
+win32-g++|unix: PRE_TARGETDEPS += $$CORE_LIB_DIR/libwasalney_core.a
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/wasalney_core.lib
+unix: LIBS += -pthread
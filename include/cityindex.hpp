@@ -0,0 +1,55 @@
+#ifndef CITYINDEX_HPP
+#define CITYINDEX_HPP
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "stringhash.hpp"
+using namespace std;
+
+// City names in sorted order, for pickers and type-ahead.
+//
+// Rows are the names sorted ignoring ASCII case. Prefix lookups binary
+// search the rows; substring lookups go through a trigram index and only
+// check the names sharing the query's rarest trigram. insert() and remove()
+// report the row that changed, so a list model can signal just that row.
+class CityIndex
+{
+public:
+    void build(const vector<string>& names);
+    void clear();
+    int size() const { return (int)order.size(); }
+    const string& name(int row) const { return names[order[row]]; }
+
+    int row(string_view name) const;         // -1 if absent
+    int insertRow(const string& name) const; // row insert(name) would use
+    int insert(const string& name);          // its row, -1 if already present
+    int remove(const string& name);          // the row it had, -1 if absent
+
+    // Rows [first, last) of names starting with prefix.
+    pair<int, int> prefixRows(const string& prefix) const;
+    // Up to limit rows of names containing text: prefix matches first, then
+    // the others, each in row order.
+    vector<int> search(const string& text, int limit) const;
+
+private:
+    static string fold(const string& s);
+    static uint32_t trigram(const char* p)
+    {
+        return (uint32_t(uint8_t(p[0])) << 16) | (uint32_t(uint8_t(p[1])) << 8) | uint8_t(p[2]);
+    }
+    static vector<uint32_t> trigrams(const string& key); // distinct
+    int lowerBound(const string& key, const string& name) const;
+    void renumber(int fromRow);
+
+    vector<string> names, keys;   // by slot; keys are folded
+    vector<int> freeSlots;
+    vector<int> order;            // slot per row
+    vector<int> rowOf;            // row per slot, -1 for free slots
+    StringMap<int> slotOf;
+    unordered_map<uint32_t, vector<int>> postings; // trigram -> slots
+};
+
+#endif // CITYINDEX_HPP
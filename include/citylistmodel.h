@@ -0,0 +1,42 @@
+#ifndef CITYLISTMODEL_H
+#define CITYLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QComboBox>
+#include <QStringList>
+#include "cityindex.hpp"
+#include "graph.hpp"
+using namespace std;
+
+// The cities of the current graph in sorted order, shared by every city
+// picker of the app.
+//
+// Edits report single cities through cityAdded() and cityRemoved(), which
+// insert or remove one row, so no picker is refilled. attach() puts the
+// model in a combo box and gives it type-ahead over CityIndex::search.
+class CityListModel : public QAbstractListModel
+{
+public:
+    explicit CityListModel(QObject* parent = nullptr);
+
+    void setGraph(const Graph* g); // nullptr shows no cities
+    void cityAdded(const QString& name);
+    void cityRemoved(const QString& name);
+
+    int rowOf(const QString& name) const; // -1 if absent
+    QStringList match(const QString& text, int limit) const;
+
+    // Shows the model in box, made editable, with a popup of matches while
+    // typing.
+    void attach(QComboBox* box);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+    static const int MATCH_LIMIT = 50; // names in the type-ahead popup
+
+    CityIndex cities;
+};
+
+#endif // CITYLISTMODEL_H
@@ -0,0 +1,56 @@
+#ifndef CITYNAME_H
+#define CITYNAME_H
+
+#include <QStringView>
+#include <QVarLengthArray>
+#include <string_view>
+using namespace std;
+
+// The UTF-8 bytes of a QString as a string_view, for the Graph and
+// CityIndex lookups, which take string_view:
+//
+//     if (g->containsCity(CityName(text))) ...
+//
+// Names up to INLINE bytes are encoded into the object itself, so a lookup
+// from a widget's text allocates nothing. Keep the CityName alive while the
+// view is used.
+class CityName
+{
+public:
+    explicit CityName(QStringView text)
+    {
+        bytes.reserve(text.size() * 3);
+        const char16_t* p = reinterpret_cast<const char16_t*>(text.utf16());
+        const char16_t* end = p + text.size();
+        while (p < end) {
+            char32_t c = *p++;
+            if (c >= 0xD800 && c < 0xDC00 && p < end && *p >= 0xDC00 && *p < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (*p++ - 0xDC00);
+            }
+            if (c < 0x80) {
+                bytes.append(char(c));
+            } else if (c < 0x800) {
+                bytes.append(char(0xC0 | c >> 6));
+                bytes.append(char(0x80 | (c & 0x3F)));
+            } else if (c < 0x10000) {
+                bytes.append(char(0xE0 | c >> 12));
+                bytes.append(char(0x80 | (c >> 6 & 0x3F)));
+                bytes.append(char(0x80 | (c & 0x3F)));
+            } else {
+                bytes.append(char(0xF0 | c >> 18));
+                bytes.append(char(0x80 | (c >> 12 & 0x3F)));
+                bytes.append(char(0x80 | (c >> 6 & 0x3F)));
+                bytes.append(char(0x80 | (c & 0x3F)));
+            }
+        }
+    }
+
+    operator string_view() const { return string_view(bytes.constData(), size_t(bytes.size())); }
+
+private:
+    static const int INLINE = 96;
+
+    QVarLengthArray<char, INLINE> bytes;
+};
+
+#endif // CITYNAME_H
@@ -0,0 +1,196 @@
+#ifndef COWVECTOR_HPP
+#define COWVECTOR_HPP
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "stringhash.hpp"
+using namespace std;
+
+// A vector stored in fixed size chunks that copies share until one of them
+// writes. Copying costs one pointer per CHUNK elements; the first write to a
+// shared chunk copies just that chunk. Graph keeps its edge lists and names
+// in these, so a snapshot of a large graph is cheap and an edit after it
+// copies only the chunks it touches.
+//
+// Copies may be read on other threads while the original is being changed:
+// a chunk is written in place only when no copy holds it any more.
+// CowStringMap below does the same for a hash map.
+template <typename T>
+class CowVector
+{
+public:
+    static const size_t CHUNK_BITS = 8;
+    static const size_t CHUNK = size_t(1) << CHUNK_BITS;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return (*chunks[i >> CHUNK_BITS])[i & (CHUNK - 1)]; }
+    // Unshares the element's chunk, so use the const overload to only read.
+    T& operator[](size_t i) { return own(i >> CHUNK_BITS)[i & (CHUNK - 1)]; }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if ((count & (CHUNK - 1)) == 0) chunks.push_back(make_shared<Chunk>());
+        T& item = own(chunks.size() - 1)[count & (CHUNK - 1)];
+        item = T(std::forward<Args>(args)...);
+        count++;
+        return item;
+    }
+    void push_back(T value) { emplace_back(std::move(value)); }
+
+    void resize(size_t n)
+    {
+        while (count < n) emplace_back();
+        if (n == count) return;
+        chunks.resize((n + CHUNK - 1) >> CHUNK_BITS);
+        count = n;
+        if (count & (CHUNK - 1)) {
+            // Slots past the end are kept empty, so they hold no memory.
+            Chunk& last = own(chunks.size() - 1);
+            for (size_t i = count & (CHUNK - 1); i < CHUNK; i++) last[i] = T();
+        }
+    }
+    void reserve(size_t n) { chunks.reserve((n + CHUNK - 1) >> CHUNK_BITS); }
+    void shrink_to_fit() { chunks.shrink_to_fit(); }
+    void clear()
+    {
+        chunks.clear();
+        count = 0;
+    }
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() {}
+        const_iterator(const CowVector* v, size_t i) : v(v), i(i) {}
+        const T& operator*() const { return (*v)[i]; }
+        const T* operator->() const { return &(*v)[i]; }
+        const_iterator& operator++()
+        {
+            i++;
+            return *this;
+        }
+        const_iterator operator++(int) { return const_iterator(v, i++); }
+        bool operator==(const const_iterator& other) const { return i == other.i; }
+        bool operator!=(const const_iterator& other) const { return i != other.i; }
+
+    private:
+        const CowVector* v = nullptr;
+        size_t i = 0;
+    };
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+private:
+    // Full size even when last, so an element is one pointer away.
+    using Chunk = array<T, CHUNK>;
+
+    Chunk& own(size_t c)
+    {
+        if (chunks[c].use_count() > 1) {
+            chunks[c] = make_shared<Chunk>(*chunks[c]);
+        } else {
+            // The last copy to let go may have read the chunk on another
+            // thread; see those reads before writing.
+            atomic_thread_fence(memory_order_acquire);
+        }
+        return *chunks[c];
+    }
+
+    vector<shared_ptr<Chunk>> chunks;
+    size_t count = 0;
+};
+
+// String keyed map split into shards by hash, shared by copies the same way:
+// a copy costs one pointer per shard, and a write copies only its shard.
+template <typename T>
+class CowStringMap
+{
+public:
+    static const size_t SHARDS = 256; // shardOf() keeps 8 bits
+
+    // Shards are created by their first write, so an empty map, such as
+    // one about to be assigned a snapshot's shards, allocates nothing.
+    CowStringMap() {}
+
+    const T* find(string_view key) const
+    {
+        const Shard* shard = shards[shardOf(key)].get();
+        if (!shard) return nullptr;
+        auto it = shard->find(key);
+        return it == shard->end() ? nullptr : &it->second;
+    }
+    void set(string_view key, T value)
+    {
+        Shard& shard = own(shardOf(key));
+        auto it = shard.find(key);
+        if (it != shard.end()) it->second = std::move(value);
+        else shard.emplace(string(key), std::move(value));
+    }
+    bool erase(string_view key)
+    {
+        size_t i = shardOf(key);
+        if (!shards[i] || !shards[i]->count(key)) return false;
+        Shard& shard = own(i);
+        shard.erase(shard.find(key));
+        return true;
+    }
+    void reserve(size_t n)
+    {
+        for (size_t i = 0; i < SHARDS; i++) own(i).reserve(n / SHARDS + 1);
+    }
+    // Calls f(value&) for every entry.
+    template <typename F>
+    void update(F f)
+    {
+        for (size_t i = 0; i < SHARDS; i++) {
+            if (!shards[i]) continue;
+            for (auto& entry : own(i)) f(entry.second);
+        }
+    }
+
+private:
+    using Shard = StringMap<T>;
+
+    // Cheaper than a second full hash: the last (up to) eight bytes, where
+    // names that share a prefix differ, multiplied and cut to the top bits.
+    static size_t shardOf(string_view key)
+    {
+        uint64_t tail = key.size();
+        size_t n = min<size_t>(key.size(), 8);
+        if (n) memcpy(&tail, key.data() + key.size() - n, n);
+        return size_t(((tail ^ key.size()) * 0x9E3779B97F4A7C15ULL) >> 56);
+    }
+
+    Shard& own(size_t i)
+    {
+        if (!shards[i]) {
+            shards[i] = make_shared<Shard>();
+        } else if (shards[i].use_count() > 1) {
+            shards[i] = make_shared<Shard>(*shards[i]);
+        } else {
+            atomic_thread_fence(memory_order_acquire); // as in CowVector::own
+        }
+        return *shards[i];
+    }
+
+    shared_ptr<Shard> shards[SHARDS];
+};
+
+#endif // COWVECTOR_HPP
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include"graph.hpp"
 #include"program.hpp"
+#include"citylistmodel.h"
 
 namespace Ui {
 class editGraph;
@@ -14,19 +15,30 @@ class editGraph : public QDialog
     Q_OBJECT
 
 public:
-    explicit editGraph(Program* program, QWidget* parent = nullptr);
+    explicit editGraph(Program* program, CityListModel* cities, QWidget* parent = nullptr);
     void populateComboBoxes();
     ~editGraph();
 
+signals:
+    void graphChanged(); // after each edit, so map views can update
+
 private slots:
     void on_insertCity_clicked();
     void on_deleteCity_clicked();
     void on_insertEdge_clicked();
     void on_deleteEdge_clicked();
+    void on_undoEdit_clicked();
+    void on_redoEdit_clicked();
+    void on_pasteEdges_clicked();
+    void on_importEdges_clicked();
 
 private:
+    void applyBulk(const string& text);
+    void updateUndoButtons();
+
     Ui::editGraph *ui;
      Program* program;
+    CityListModel* cities; // shared with the other pickers, told about each edit
 };
 
 #endif // EDITGRAPH_H
@@ -2,8 +2,14 @@
 #define EXPLOREMAP_H
 
 #include <QDialog>
+#include <QTimer>
 #include"graph.hpp"
+#include"graphlayout.hpp"
+#include"layoutworker.hpp"
 #include"program.hpp"
+#include"mapscene.h"
+#include"searchrecorder.hpp"
+#include"citylistmodel.h"
 using namespace std;
 namespace Ui {
 class ExploreMap;
@@ -14,7 +20,7 @@ class ExploreMap : public QDialog
     Q_OBJECT
 
 public:
-    explicit ExploreMap(Program* program, QWidget* parent = nullptr);
+    explicit ExploreMap(Program* program, CityListModel* cities, QWidget* parent = nullptr);
     void populateComboBoxes();
     ~ExploreMap();
     struct City {
@@ -25,10 +31,33 @@ public:
 private slots:
     void on_findPath_clicked();
     void showPath(const vector<string>& highlightPath, char mode);
+    void replayStep();
 
 private:
+    void showMap(char mode); // draws the whole graph; positions may follow from the pool
+    void pickCity(const QString& city);
+    void showEdge(const QString& from, const QString& to); // highlights it with its weights
+    void highlightPath(const vector<string>& path);
+
     Ui::ExploreMap *ui;
      Program* program;
+    CityListModel* cities;
+    MapScene* mapScene;
+    static const int LAYOUT_FRAME_EVERY = 10; // iterations between redraws
+    LayoutWorker layoutWorker;
+    int layoutGeneration = 0; // frames of replaced layouts are dropped
+
+    // The last search's settle and relax events, replayed a few per tick
+    // before its path is drawn.
+    static const int REPLAY_TICK_MS = 30;
+    static constexpr size_t MAX_REPLAY_EVENTS = size_t(1) << 22; // 48 MB of events
+    SearchRecorder recorder;
+    QTimer* replayTimer;
+    size_t replayNext = 0;
+    vector<string> replayPath;
+    shared_ptr<const Graph> replayGraph;
+    uint64_t replayVersion = 0; // the replay stops if the graph changes
+    CancelToken searchToken;    // of the search still running, if any
 };
 
 #endif // EXPLOREMAP_H
@@ -2,20 +2,24 @@
 #define FILEHANDLER_HPP
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include "graph.hpp"
 #include<vector>
 using namespace std;
+// Graphs are owned by the caller (Program); the handler only fills or reads
+// that store so loading and saving never copy whole graphs.
+// Nothing here talks to the user: on failure the functions return false and
+// leave the reason in lastError for the caller to show.
 class Filehandler
 {
 
 public:
     int numberOfGraphs;///isssu !! we need to add number of cities in each graph
     int numOfCitiesInFile;//this will be deleted ,used just for testing
-    vector<Graph>graphs;
+    string lastError;
     Filehandler();
-    void ReadGraphFromFile(const string& filename);
-    void SaveInFile(const string& filename);
-    void setGraphs(const vector<Graph>& g);
+    bool ReadGraphFromFile(const string& filename, vector<shared_ptr<Graph>>& graphs);
+    bool SaveInFile(const string& filename, const vector<shared_ptr<Graph>>& graphs);
 };
 
 #endif // FILEHANDLER_HPP
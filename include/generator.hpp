@@ -0,0 +1,84 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+#include <coroutine>
+#include <exception>
+#include <utility>
+using namespace std;
+
+// Values produced one at a time by a coroutine that co_yields them.
+//
+// The coroutine only runs inside next(), up to its following co_yield, so a
+// consumer can take one value per timer tick. Destroying the generator
+// cancels whatever work the coroutine had left.
+template <typename T>
+class Generator
+{
+public:
+    struct promise_type;
+    using Handle = coroutine_handle<promise_type>;
+
+    struct promise_type {
+        T current{};
+        exception_ptr error;
+
+        Generator get_return_object() { return Generator(Handle::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        suspend_always yield_value(T value) { current = std::move(value); return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = current_exception(); }
+    };
+
+    Generator() = default;
+    Generator(Generator&& other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Generator& operator=(Generator&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            handle = exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+    ~Generator() { reset(); }
+
+    // Runs to the next value; false once the coroutine has returned.
+    bool next()
+    {
+        if (done()) return false;
+        handle.resume();
+        if (handle.promise().error) rethrow_exception(exchange(handle.promise().error, nullptr));
+        return !handle.done();
+    }
+    const T& value() const { return handle.promise().current; }
+    bool done() const { return !handle || handle.done(); }
+    void reset()
+    {
+        if (handle) handle.destroy();
+        handle = nullptr;
+    }
+
+    // For range-for; begin() runs to the first value.
+    struct Sentinel {};
+    class Iterator
+    {
+    public:
+        explicit Iterator(Generator* owner) : owner(owner) {}
+        const T& operator*() const { return owner->value(); }
+        Iterator& operator++() { owner->next(); return *this; }
+        bool operator==(Sentinel) const { return owner->done(); }
+
+    private:
+        Generator* owner;
+    };
+    Iterator begin() { next(); return Iterator(this); }
+    Sentinel end() { return {}; }
+
+private:
+    explicit Generator(Handle handle) : handle(handle) {}
+
+    Handle handle = nullptr;
+};
+
+#endif // GENERATOR_HPP
@@ -4,33 +4,222 @@
 #include <queue>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <limits>
+#include <vector>
+#include <memory>
+#include <cstdint>
 #include<algorithm>
+#include <atomic>
+#include "cowvector.hpp"
+#include "generator.hpp"
+#include "querystats.hpp"
+#include "stringhash.hpp"
 
 using namespace std;
 
 class Graph {
 private:
+    // contentHash() of version; snapshots are hashed from several threads.
+    struct HashCache {
+        atomic<uint64_t> hash{0};
+        atomic<uint64_t> version{UINT64_MAX};
+        HashCache() {}
+        HashCache(const HashCache& other) { *this = other; }
+        HashCache& operator=(const HashCache& other)
+        {
+            hash.store(other.hash.load(memory_order_relaxed), memory_order_relaxed);
+            version.store(other.version.load(memory_order_relaxed), memory_order_relaxed);
+            return *this;
+        }
+    };
+    mutable HashCache cachedHash;
+
+    // One reversible change in the undo log. City changes name the city by
+    // an index into History::names.
+    struct Change {
+        enum Kind : uint8_t { CityAdded, CityRemoved, EdgeAdded, EdgeChanged, EdgeRemoved };
+        Kind kind;
+        uint32_t name;
+        int u, v;
+        double distance, time;        // after the change; before it for EdgeRemoved
+        double oldDistance, oldTime;  // EdgeChanged only
+    };
+    struct History {
+        vector<Change> changes;
+        vector<string> names;
+        vector<size_t> ends;          // end of each committed transaction in changes
+        size_t applied = 0;           // transactions not undone; the rest can be redone
+        int depth = 0;                // nested beginTransaction() calls
+        size_t openStart = 0;         // where the open transaction's changes start
+        vector<size_t> nested;        // where each nested level's changes start
+        bool recorded = false;        // the open transaction logged a change
+        bool dirty = false;           // the open transaction bumped version
+        uint64_t epoch = newEpoch();  // changes when logged changes stop describing the graph
+        size_t kept = SIZE_MAX;       // leading transactions no new one has replaced since epoch
+    } history;
+    static uint64_t newEpoch(); // unique in the process, so no two graphs share one
+    void record(Change::Kind kind, int u, int v = -1, double distance = 0, double time = 0,
+                double oldDistance = 0, double oldTime = 0);
+    void changed(); // bumps version, once per transaction
+    void apply(const Change& c, bool forward);
+    void revertChanges(size_t start); // undoes and drops changes from start on
+    void setEdge(int u, int v, double distance, double time);
+    void removeEdge(int u, int v);
+    template <typename Visitor>
+    void shortestPath(int start, int destination, bool byTime, vector<int>& path, double& cost,
+                      Visitor& visitor, QueryStats& stats) const;
 
 public:
     struct PathResult {
         vector<string> path;
         double distanceOrTime = 0.0;
+        QueryStats stats; // all zero unless built with WASALNEY_QUERY_STATS
+    };
+    struct Edge {
+        int to;
+        double distance;
+        double time;
+    };
+    // Connected component label per city id. Only trusted while graphVersion
+    // matches the graph's version.
+    struct ComponentIndex {
+        uint64_t graphVersion = 0;
+        int count = 0;
+        vector<int> label;
+    };
+    // Drawing positions by city id (NaN for ids without a position), shared
+    // by every view of the graph. Exact while graphVersion matches; an older
+    // one seeds an incremental re-layout that only moves what an edit touched.
+    struct LayoutPositions {
+        uint64_t graphVersion = 0;
+        float width = 0, height = 0;      // area the positions were fitted to
+        vector<float> x, y;
+        vector<uint64_t> edgeSignature;   // per city id, see GraphLayout::EdgeSignatures
+    };
+    // One step of a search, for drawing it as it happens. Visit: city is
+    // taken from the queue, stack or heap. Relax: city was reached (again,
+    // more cheaply) over the edge from "from". cost is hops from the start
+    // for BFS/DFS and distance or time for Dijkstra.
+    struct TraversalEvent {
+        enum Kind { Visit, Relax };
+        Kind kind = Visit;
+        int city = -1;
+        int from = -1;  // -1 for the start
+        double cost = 0.0;
     };
     int numberOfCities = 0;
     string name;
-    unordered_map<string, unordered_map<string, pair<double, double>>> adj;
-    vector<string>getAllCities();
-    int getnumberOfCities();
-    void addCity(const string& name);
-    void addEdge(const string& src, const string& dest, double distance, double time);
-    void deleteCity(const string& name);
-    void deleteEdge(const string& src, const string& dest);
-    bool containsCity(const string& name);
-    bool containsEdge(const string& city1, const string& city2);
-    vector<string> BFS(const string& start);
-    vector<string> DFS(const string& start);
-    PathResult DijkstraDistance(const string& start, const string& destination);
-    PathResult DijkstraTime(const string& start, const string& destination);
+
+    // Cities are stored by integer id. A deleted city keeps its id with an
+    // empty name and no edges, so ids handed out earlier stay stable.
+    // Read these through a const Graph where possible: writing through the
+    // non-const operator[] unshares the chunk from snapshots.
+    CowVector<string> cityNames;
+    CowVector<vector<Edge>> adj; // adj[id] = incident edges, always kept symmetric
+    CowStringMap<int> cityIds;
+    // Bumped on every change so caches and indices can tell they are stale.
+    uint64_t version = 0;
+    // Set by Program, possibly from a background thread; use atomic_load/atomic_store.
+    shared_ptr<const ComponentIndex> components;
+    shared_ptr<const LayoutPositions> layout; // same access rules as components
+    // Latest snapshot() published by Program for other threads; same access
+    // rules as components.
+    shared_ptr<const Graph> published;
+
+    // An immutable copy of this version for readers on other threads, without
+    // the undo history. Edge lists and names are shared with this graph and
+    // only copied, a chunk at a time, when this graph changes them.
+    shared_ptr<const Graph> snapshot() const;
+
+    vector<string>getAllCities() const;
+    int getnumberOfCities() const;
+    void addCity(string_view name);
+    void addEdge(string_view src, string_view dest, double distance, double time);
+    void deleteCity(string_view name);
+    // Removes every listed city that exists, touching each surviving
+    // neighbour's edge list once, then compacts the ids unless a transaction
+    // is open. Returns how many cities were removed.
+    int deleteCities(const vector<string>& names);
+    void deleteEdge(string_view src, string_view dest);
+    bool containsCity(string_view name) const;
+    bool containsEdge(string_view city1, string_view city2) const;
+    vector<string> BFS(string_view start) const;
+    vector<string> DFS(string_view start) const;
+    PathResult DijkstraDistance(string_view start, string_view destination) const;
+    PathResult DijkstraTime(string_view start, string_view destination) const;
+    // Hooks of the shortest path search: settle() when a city's cost becomes
+    // final, relax() when a cheaper way to a city is found. They are called
+    // straight from the search loop, so the default visitor costs nothing.
+    struct NoVisitor {
+        void settle(int, int, double) {}
+        void relax(int, int, double) {}
+    };
+    // Compiled in graph.cpp for NoVisitor and SearchRecorder.
+    template <typename Visitor>
+    PathResult Dijkstra(string_view start, string_view destination, bool byTime, Visitor& visitor) const;
+    // Cost from start to every city id (infinity when unreachable or beyond
+    // limit). Used for distance matrices and isochrones.
+    vector<double> DijkstraFrom(int start, bool byTime, double limit = numeric_limits<double>::infinity()) const;
+    // The same searches as events, produced lazily one per next(). Visits
+    // come in the order of BFS()/DFS(); Dijkstra stops after destination
+    // (-1 = settle everything). A generator ends early if the graph changes.
+    Generator<TraversalEvent> BFSSteps(int start) const;
+    Generator<TraversalEvent> DFSSteps(int start) const;
+    Generator<TraversalEvent> DijkstraSteps(int start, bool byTime, int destination = -1) const;
+
+    // Transactions batch edits into one undo step. Inside one, version is
+    // bumped by the first change and by commit, not by every change, so
+    // caches and indices are invalidated once for the whole batch.
+    // Transactions nest; only the outermost commit counts, and a rollback
+    // reverts only the innermost open level. Edits made outside a transaction
+    // are not logged and clear the undo history.
+    void beginTransaction();
+    bool commitTransaction();   // false if nothing was logged
+    void rollbackTransaction(); // reverts the innermost open transaction
+    bool inTransaction() const { return history.depth > 0; }
+    bool canUndo() const { return history.depth == 0 && history.applied > 0; }
+    bool canRedo() const { return history.depth == 0 && history.applied < history.ends.size(); }
+    bool undo();
+    bool redo();
+    void clearHistory();
+
+    // Where the undo log stood, so a view can later catch up by replaying
+    // what changed instead of reading the whole graph again.
+    struct LogPosition {
+        uint64_t epoch = 0; // 0 never matches: the view reads everything
+        size_t applied = 0;
+    };
+    LogPosition logPosition() const;
+    // Adds the ids of the cities and the id pairs of the edges that commits,
+    // undo or redo added, removed or changed since p; what they are now is
+    // read from the graph. False if the log cannot tell, because of an edit
+    // outside a transaction, a cleared history or compact(), or an open
+    // transaction, or if more than limit changes would be replayed.
+    bool changedSince(const LogPosition& p, size_t limit, vector<int>& cities,
+                      vector<pair<int, int>>& edges) const;
+
+    // Id based access, used by the importers and the drawing code.
+    int cityId(string_view name) const;   // -1 if the city does not exist
+    int idCount() const { return (int)cityNames.size(); }
+    bool isCity(int id) const { return id >= 0 && id < idCount() && !cityNames[id].empty(); }
+    int addCityId(string_view name);      // returns the existing id if already present
+    void reserveCities(int count);
+    void addEdgeById(int src, int dest, double distance, double time);
+    const Edge* findEdge(int src, int dest) const;
+    // Renumbers the live cities to 0..n-1 in id order, dropping the ids of
+    // deleted cities. Cached components and layout are remapped along; the
+    // undo history is cleared since its ids no longer apply. Returns the new
+    // id per old id (-1 for deleted ones), or an empty vector if there was
+    // nothing to drop. Not allowed inside a transaction.
+    vector<int> compact();
+
+    // Hash of the cities and edges that does not depend on id order, so a graph
+    // reloaded from file hashes the same as the one that was saved.
+    uint64_t contentHash() const;
+    // Labels components over a flat (offsets, targets) copy of the adjacency,
+    // which lets it run on a worker thread while the graph keeps changing.
+    static shared_ptr<ComponentIndex> BuildComponentIndex(const vector<int>& offsets, const vector<int>& targets);
+    void flatAdjacency(vector<int>& offsets, vector<int>& targets) const;
 };
@@ -0,0 +1,40 @@
+#ifndef GRAPHIMPORTER_HPP
+#define GRAPHIMPORTER_HPP
+#include <string>
+#include <string_view>
+#include <vector>
+#include "graph.hpp"
+using namespace std;
+// Streaming importers for map formats other than the filename.txt format.
+// Files are read in large chunks and numbers are parsed in place, and cities
+// and edges are written straight into the graph's id based storage.
+class GraphImporter
+{
+public:
+    string lastError;
+    long long linesRead = 0;
+    // Filled by ImportDimacs when a .co file is given, indexed by city id;
+    // NaN for nodes the file does not list.
+    vector<double> coordX, coordY;
+
+    // DIMACS shortest path format ("p sp n m" / "a u v w"). City names are the
+    // DIMACS node numbers. When timeGrPath is empty the time of every edge
+    // equals its distance; otherwise it must list the same arcs in the same order.
+    // Files from wasalney_mapgen are in metres and seconds; the scale noted in
+    // their "c wasalney_mapgen" line turns the weights back into km and hours.
+    bool ImportDimacs(const string& grPath, Graph& g,
+                      const string& timeGrPath = "", const string& coPath = "");
+
+    // One edge per line: source, destination, distance[, time]. The delimiter
+    // (comma, tab, semicolon or space) is detected from the first line, and a
+    // first line with non numeric weights is treated as a header. Names with
+    // spaces, which the map file cannot hold, and non-finite weights fail.
+    bool ImportEdgeList(const string& path, Graph& g);
+
+    // Adds pasted text to an existing graph as one transaction, so it is a
+    // single undo step. Lines are edges as for ImportEdgeList, or a lone city
+    // name. On an invalid line nothing is changed.
+    bool ApplyEdgeList(string_view text, Graph& g);
+};
+
+#endif // GRAPHIMPORTER_HPP
@@ -0,0 +1,124 @@
+#ifndef GRAPHLAYOUT_HPP
+#define GRAPHLAYOUT_HPP
+#include "graph.hpp"
+#include "layoutkernel.hpp"
+#include <functional>
+#include <vector>
+using namespace std;
+
+// Layout tuning; the defaults are the constants of the original layout loop.
+struct LayoutOptions {
+    int iterations = 150;   // iteration budget
+    int incrementalIterations = 40; // budget after seed()
+    double theta = 0.8;     // 0 = exact all pairs, larger = coarser
+    double width = 800;     // target area
+    double height = 600;
+    double repulsion = 10000.0;
+    double springK = 0.002;
+    double damping = 0.85;
+    double padding = 50.0;
+    bool byTime = false;    // spring lengths from edge times instead of distances
+    // Coarsen, lay out the coarsest level, then refine level by level; used
+    // for graphs with at least multilevelMinCities cities that were not seeded.
+    bool multilevel = true;
+    int multilevelMinCities = 500;
+    int refineIterations = 20; // per level, including the final one
+    const LayoutKernel* kernel = nullptr; // inner loops; nullptr = best for this CPU
+};
+
+// Scale free layout quality, to compare layout modes.
+struct LayoutQuality {
+    double edgeLengthVariance = 0; // variance of edge length / mean edge length
+    long long crossingPairs = 0;   // edge pairs sampled
+    long long crossings = 0;       // of which cross
+    double crossingRate() const { return crossingPairs ? double(crossings) / crossingPairs : 0.0; }
+};
+
+// Force directed layout shared by the map view and the path view.
+//
+// Repulsion is approximated with a Barnes-Hut quadtree (O(n log n) per
+// iteration), springs run over a flat copy of the edges. Positions,
+// velocities and forces live in float arrays indexed by city id; deleted ids
+// are skipped. Leaf sums, springs and integration go through a LayoutKernel,
+// vectorized when every city moves. The graph is only read in the constructor, so a layout can be
+// stepped while the graph keeps changing.
+class GraphLayout
+{
+public:
+    GraphLayout(const Graph& g, const LayoutOptions& options = LayoutOptions());
+
+    void step();                   // runs one iteration
+    void run();                    // runs the remaining iteration budget
+    bool done() const { return iteration >= options.iterations; }
+    int iterationsDone() const { return iteration; }
+    // Scales and centers the positions into the target area, like the
+    // original layout did after its last iteration.
+    void fitToView();
+    // The same, into copies, for showing a layout that is still running.
+    void fittedPositions(vector<float>& outX, vector<float>& outY) const;
+
+    // Starts from positions cached for an earlier version of the graph.
+    // Cities whose edges did not change keep their place; new or changed
+    // cities and their neighbours start next to their neighbours and are the
+    // only ones that move. Returns false and changes nothing when too much
+    // changed for that to look right.
+    bool seed(const Graph::LayoutPositions& previous);
+    // Current positions tagged with the graph version, for Graph::layout.
+    shared_ptr<Graph::LayoutPositions> snapshot() const;
+    // Per city hash of its incident edges; seed() compares them to find the
+    // cities an edit touched.
+    static vector<uint64_t> EdgeSignatures(const Graph& g);
+    // Samples up to samplePairs random edge pairs for crossings.
+    static LayoutQuality Measure(const Graph& g, const vector<float>& x, const vector<float>& y,
+                                 long long samplePairs = 200000);
+
+    bool hasCity(int id) const { return id >= 0 && id < (int)live.size() && live[id]; }
+
+    LayoutOptions options;
+    vector<float> x, y;            // by city id
+    // Called by the first step() of a multilevel layout after each coarse
+    // level is placed, with x and y holding every city at its group's place.
+    // Returning false abandons the layout: done() turns true.
+    function<bool()> onLevel;
+
+private:
+    struct QuadNode {
+        float cx, cy, mass;        // center of mass
+        float midX, midY, half;    // square cell
+        int child[4];              // -1 for none
+        int first, count;          // bodies of a leaf, in order[]
+    };
+
+    // One level of the multilevel hierarchy: all nodes live, ids 0..n-1.
+    GraphLayout(const LayoutOptions& options, vector<int> offsets, vector<int> targets,
+                vector<float> lengths);
+    void placeMultilevel();
+
+    void prepareEdges();
+    int build(int first, int count, float midX, float midY, float half, int depth);
+    void applyRepulsion();
+    void applySprings();
+    void integrate();
+
+    int iteration = 0;
+    uint64_t graphVersion = 0;
+    bool seeded = false;
+    double areaWidth, areaHeight;  // where nodes may move; larger than the view for big multilevel layouts
+    float speedScale = 1.0f;
+    float centerRadius = 300.0f;
+    float repulsionCutoff = 0;     // ignore cells farther than this; 0 = none
+    const LayoutKernel* kernel;
+    vector<char> live;
+    vector<int> ids;               // live city ids
+    vector<int> movers;            // ids that get forces and move; all of ids unless seeded
+    vector<uint64_t> signature;
+    FloatArray vx, vy, fx, fy;
+    vector<int> edgeOffsets, edgeSources, edgeTargets;
+    vector<float> edgeLength;      // ideal length per directed edge
+    FloatArray springX, springY;   // spring force per directed edge, on its source
+    vector<QuadNode> tree;
+    vector<int> order;             // body ids, grouped by leaf
+    FloatArray orderX, orderY;     // their positions, contiguous for the leaf loops
+};
+
+#endif // GRAPHLAYOUT_HPP
@@ -8,6 +8,10 @@
 #include <QBrush>
 #include <QPen>
 #include <QDebug>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+using namespace std;
 // we should use this instead of the addEllipse , adn addline this will make the map interactive
 // as you can click any where you like or
 class CityNode : public QGraphicsEllipseItem {
@@ -35,23 +39,86 @@ protected:
 };
 
 
-class EdgeLine : public QGraphicsLineItem {
+// All edges of a map as one item. Painting asks a uniform grid for the
+// segments in the exposed rect, so a zoomed in view only touches what it
+// shows, and a map with thousands of edges costs one item instead of two per
+// edge.
+class EdgeBatch : public QGraphicsItem {
 public:
-    QString fromCity;
-    QString toCity;
+    struct Edge {
+        int from, to;              // city ids
+        QString fromCity, toCity;
+        QString label;             // distance or time
+    };
 
-    EdgeLine(const QLineF& line, const QString& from, const QString& to)
-        : QGraphicsLineItem(line), fromCity(from), toCity(to) {
-        setPen(QPen(Qt::red, 3));
-        setAcceptHoverEvents(true);
-        setFlag(QGraphicsItem::ItemIsSelectable);
-    }
+    EdgeBatch();
+    // Replaces the edges; ones that were already there keep their color.
+    void setEdges(vector<Edge> edges);
+    // Adds an edge or replaces the one between the same cities, which keeps
+    // its color; removeEdge() drops one. Like setEdges(), nothing is drawn
+    // until the next setPositions().
+    void setEdge(const Edge& edge);
+    void removeEdge(int from, int to);
+    // Positions by city id; rebuilds the grid.
+    void setPositions(const vector<float>& x, const vector<float>& y);
+    int find(int from, int to) const;           // -1 if there is no such edge
+    const Edge& edge(int i) const { return edges[i]; }
+    void setColor(int edge, const QColor& color);
+    QColor color(int edge) const;               // invalid = the default pen
+    void resetColors();
+    void setLabelsVisible(bool visible);
+    // Nearest edge within tolerance of pos, -1 if none.
+    int edgeAt(const QPointF& pos, qreal tolerance) const;
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    vector<int> query(const QRectF& rect) const;
+    void clearLines(); // the grid is stale until setPositions()
+
+    vector<Edge> edges;
+    vector<QLineF> lines;
+    vector<QColor> colors;         // invalid = the default pen
+    unordered_map<uint64_t, int> byEnds;
+    bool labelsVisible = true;
+    QRectF bounds;
+    // Grid over bounds in CSR form; edges spanning many cells go to longEdges.
+    qreal cellSize = 1;
+    int columns = 0, rows = 0;
+    vector<int> cellStart, cellEdges, longEdges;
+    mutable vector<int> seen;      // query() stamps, to report each edge once
+    mutable int stamp = 0;
+};
+
+// Cities merged per screen cell, shown instead of the city items when they
+// would be too dense to tell apart. Clicking a cluster calls onClicked with
+// the area of its cities.
+class ClusterLayer : public QGraphicsItem {
+public:
+    ClusterLayer();
+    void setPositions(const vector<float>& x, const vector<float>& y, const vector<int>& ids);
+    void setCellSize(qreal size); // in scene units
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+    function<void(const QRectF&)> onClicked;
 
 protected:
-    void mousePressEvent(QGraphicsSceneMouseEvent* event) override {
-        qDebug() << "Edge clicked from" << fromCity << "to" << toCity;
-        QGraphicsLineItem::mousePressEvent(event);
-    }
+    void mousePressEvent(QGraphicsSceneMouseEvent* event) override;
+
+private:
+    struct Cluster {
+        QPointF center;
+        QRectF area;               // bounds of its cities
+        int count;
+    };
+    void rebuild();
+
+    vector<QPointF> points;
+    vector<Cluster> clusters;
+    qreal cellSize = 50;
+    QRectF bounds;
 };
 
 #endif
@@ -0,0 +1,40 @@
+#ifndef GUITASK_H
+#define GUITASK_H
+
+#include <QCoreApplication>
+#include <QObject>
+#include <QPointer>
+#include <memory>
+#include <utility>
+#include "taskpool.hpp"
+using namespace std;
+
+// Runs work(token) on the pool and hands its result to done(result) on the
+// GUI thread through a queued call:
+//
+//     searchToken.cancel();
+//     searchToken = CancelToken();
+//     runTask(program->pool, this, searchToken,
+//             [g](const CancelToken& token) { return g->BFS(...); },
+//             [this](vector<string> order) { ... });
+//
+// work runs on a worker thread, so it must only read data it owns or
+// immutable snapshots (Program::snapshot). done is dropped when the token was
+// cancelled or receiver was deleted by the time it would run; cancelling is
+// how to discard a result that a newer request replaces.
+template <typename Work, typename Done>
+void runTask(TaskPool& pool, QObject* receiver, CancelToken token, Work work, Done done,
+             TaskPool::Priority priority = TaskPool::Interactive)
+{
+    QPointer<QObject> guard(receiver);
+    pool.submit([guard, token, work = std::move(work), done = std::move(done)]() mutable {
+        if (token.cancelled()) return;
+        auto result = make_shared<decltype(work(token))>(work(token));
+        if (token.cancelled()) return;
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, token, done = std::move(done), result]() mutable {
+            if (guard && !token.cancelled()) done(std::move(*result));
+        }, Qt::QueuedConnection);
+    }, priority);
+}
+
+#endif // GUITASK_H
@@ -0,0 +1,80 @@
+#ifndef INDEXSTORE_HPP
+#define INDEXSTORE_HPP
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "graph.hpp"
+using namespace std;
+
+// Sidecar file holding precomputed indices for one graph of a map file
+// (component labels, layouts, ...). The file is memory mapped on open and
+// only trusted when its format version and the graph's content hash match.
+//
+// Layout: Header, section table, stored city names, then 8 byte aligned
+// section data. Per city sections hold one element per stored city, in the
+// order the names were stored.
+class IndexStore
+{
+public:
+    static const uint32_t FormatVersion = 1;
+
+    struct Section {
+        string tag;               // at most 15 characters
+        uint32_t elementSize = 1;
+        const void* data = nullptr;
+        uint64_t count = 0;
+    };
+
+    IndexStore();
+    ~IndexStore();
+    IndexStore(const IndexStore&) = delete;
+    IndexStore& operator=(const IndexStore&) = delete;
+
+    // <map file>.<graph name>.idx, other characters than letters, digits, '-'
+    // and '_' escaped as %XX.
+    static string SidecarPath(const string& mapFile, const string& graphName);
+    // Writes to a temporary file and renames it, so readers never see half a file.
+    // Takes the city names (id order, empty for deleted ids) and content hash
+    // instead of the graph so a worker thread can save from a snapshot.
+    static bool Save(const string& path, const vector<string>& cityNames, uint64_t contentHash,
+                     const vector<Section>& sections, string& error);
+
+    // Maps the file and validates it against g. On failure lastError says why.
+    bool Open(const string& path, const Graph& g);
+    void Close();
+    bool isOpen() const { return base != nullptr; }
+
+    // Zero copy access in stored city order, which is id order when sameIds().
+    const void* view(const string& tag, uint32_t elementSize, uint64_t& count) const;
+    bool sameIds() const { return idsMatch; }
+
+    // Copies a per city section into graph id order, remapping by name when the
+    // ids changed since the file was written. Cities not in the file get fill.
+    template <typename T>
+    bool readPerCity(const string& tag, vector<T>& out, const T& fill) const {
+        uint64_t count = 0;
+        const T* data = static_cast<const T*>(view(tag, sizeof(T), count));
+        if (!data || count != storedToId.size()) return false;
+        out.assign(idCount, fill);
+        for (size_t i = 0; i < storedToId.size(); i++) {
+            if (storedToId[i] >= 0) memcpy(&out[storedToId[i]], &data[i], sizeof(T));
+        }
+        return true;
+    }
+
+    string lastError;
+
+private:
+    struct Header;
+    struct SectionEntry;
+    const char* base = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr; // platform handle
+    bool idsMatch = false;
+    int idCount = 0;
+    vector<int> storedToId;
+};
+
+#endif // INDEXSTORE_HPP
@@ -0,0 +1,69 @@
+#ifndef LAYOUTKERNEL_HPP
+#define LAYOUTKERNEL_HPP
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <vector>
+using namespace std;
+
+// Allocator for arrays the SIMD kernels stream through, so they start on a
+// 32 byte (AVX) boundary.
+template <typename T, size_t Alignment = 32>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(Alignment))); }
+    void deallocate(T* p, size_t) { ::operator delete(p, align_val_t(Alignment)); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+using FloatArray = vector<float, AlignedAllocator<float>>;
+
+// Repulsion on a body at offset (dx, dy) from a mass; the force law of the
+// original layout loop. Coincident bodies do not push each other.
+inline void repelOne(float dx, float dy, float mass, float repulsion, float& fx, float& fy)
+{
+    float d2 = dx * dx + dy * dy;
+    if (d2 == 0.0f) return;
+    d2 = max(d2, 1.0f);
+    float d = sqrt(d2);
+    float strength = min(repulsion / d2, 200.0f) * mass;
+    fx += dx * (strength / d);
+    fy += dy * (strength / d);
+}
+
+// Inner loops of GraphLayout, in a scalar version and SIMD versions picked
+// at run time from what the CPU supports. All versions compute the same
+// forces up to float rounding.
+struct LayoutKernel {
+    struct IntegrateParams {
+        float centerX, centerY, centerRadius; // pull toward the center beyond the radius
+        float damping, maxSpeed;
+        float minX, maxX, minY, maxY;         // clamp box
+        bool settling;                        // extra damping late in the run
+    };
+
+    const char* name;
+    // Adds the repulsion of count unit bodies to (ax, ay).
+    void (*repel)(float px, float py, const float* xs, const float* ys, int count,
+                  float repulsion, float& ax, float& ay);
+    // Spring force on the source end of each edge, one value per edge.
+    void (*springs)(const int* sources, const int* targets, const float* lengths, int count,
+                    const float* x, const float* y, float springK, float* outX, float* outY);
+    // Center pull, velocity update, speed cap and clamp for bodies [0, count);
+    // clears the forces.
+    void (*integrate)(const IntegrateParams& p, float* x, float* y, float* vx, float* vy,
+                      float* fx, float* fy, int count);
+
+    static const LayoutKernel& Best();   // chosen once per process
+    static const LayoutKernel& Scalar();
+    static vector<const LayoutKernel*> Available();
+};
+
+#endif // LAYOUTKERNEL_HPP
@@ -0,0 +1,58 @@
+#ifndef LAYOUTWORKER_HPP
+#define LAYOUTWORKER_HPP
+#include "graphlayout.hpp"
+#include "taskpool.hpp"
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// Runs a GraphLayout as a background task on a TaskPool and reports
+// positions every few iterations, so a view can show the map settling instead
+// of freezing.
+//
+// start() cancels the running layout without waiting for it: the old task
+// notices its token at the next iteration, stops and is reaped later. Frames
+// are delivered on the worker thread; GUI code should queue them to its own
+// thread and drop frames from layouts it has since replaced.
+class LayoutWorker
+{
+public:
+    struct Frame {
+        vector<float> x, y;   // by city id
+        int iteration = 0;
+        bool finished = false; // last frame, already fitted to the view
+        shared_ptr<const Graph::LayoutPositions> result; // finished frames only, for Graph::layout
+    };
+    using Callback = function<void(shared_ptr<const Frame>)>;
+
+    explicit LayoutWorker(TaskPool& pool) : pool(pool) {}
+    ~LayoutWorker();
+    LayoutWorker(const LayoutWorker&) = delete;
+    LayoutWorker& operator=(const LayoutWorker&) = delete;
+
+    // Lays out the snapshot g in the background, building the layout there
+    // too since that reads the whole graph. The first frame (iteration 0)
+    // holds the starting positions, and a multilevel layout sends one per
+    // coarse level. A cached layout (possibly for an older version of g)
+    // seeds an incremental run.
+    void start(shared_ptr<const Graph> g, const LayoutOptions& options, int frameEvery, Callback callback,
+               shared_ptr<const Graph::LayoutPositions> previous = nullptr);
+    void cancel();
+    // Cancels and waits for every layout task; after it returns no callback runs.
+    void stop();
+    bool running() const;
+
+private:
+    struct Job {
+        CancelToken token;
+        shared_future<void> finished;
+    };
+    static bool isDone(const Job& job);
+    void reap(bool wait);
+    TaskPool& pool;
+    vector<Job> jobs;
+};
+
+#endif // LAYOUTWORKER_HPP
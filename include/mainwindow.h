@@ -3,9 +3,11 @@
 #include<math.h>
 #include <QCloseEvent>
 #include <QMainWindow>
-#include "graphviewitems.hpp"
+#include "mapscene.h"
+#include "citylistmodel.h"
 #include <vector>
 #include "graph.hpp"
+#include "layoutworker.hpp"
 #include "filehandler.hpp"
 #include "qmessagebox.h"
 #include  "QGraphicsScene"
@@ -14,6 +16,7 @@
 #include "QGraphicsLineItem"
 #include"QLineEdit"
 #include"QInputDialog"
+#include <QFileDialog>
 #include "set"
 #include "program.hpp"
 #include"ui_exploremap.h"
@@ -35,29 +38,55 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
-    void animateTraversal(const vector<string>& path);
+    // Shows the events one per tick, from a graph kept alive until it ends.
+    void animateTraversal(shared_ptr<const Graph> graph, Generator<Graph::TraversalEvent> events);
     void resetGraphColors();
 private slots:
     void onMapSelectionChanged(int index);
     void ShowMap(int index);
+    void refreshMap();
     void on_exploreButton_clicked();
     void on_addGraphButton_clicked();
     void on_deleteGraphButton_clicked();
+    void on_importGraphButton_clicked();
     void updateGraphComboBox();
     void on_BFS_clicked();
     void on_DFS_clicked();
+    void on_dijkstra_clicked();
+    void on_pauseTraversal_clicked();
+    void on_stepBack_clicked();
+    void on_cancelTraversal_clicked();
     void on_editGraph_clicked();
 
     void on_saveBtn_clicked();
     void animateTraversalStep();
     void closeEvent(QCloseEvent *event) override;
 private:
+    static const int LAYOUT_FRAME_EVERY = 10; // iterations between redraws
+    static const int ANIMATION_TICK_MS = 250;
+    void applyLayoutFrame(const LayoutWorker::Frame& frame);
+
+    // An applied traversal event with what it painted over, so stepping back
+    // only restores the one city and edge it touched.
+    struct AnimationStep {
+        Graph::TraversalEvent event;
+        QString city, from;  // names at the time, in case the graph changes later
+        QColor cityBefore, edgeBefore;
+        int textAdded = 0; // characters appended to the traversal text
+    };
+    bool stepForward();
+    void stopTraversal(); // forgets the traversal, keeps its colors
+
     Ui::MainWindow *ui;
     Program program;
     QTimer* animationTimer;
-    QVector<QString> animationPath;
-    int currentAnimationStep;
-    QMap<QString, CityNode*> cityNodes;
-    QMap<QPair<QString, QString>, EdgeLine*> edgeLines;
+    shared_ptr<const Graph> animationGraph;
+    Generator<Graph::TraversalEvent> animationEvents;
+    vector<AnimationStep> animationSteps; // pulled so far; stepping back replays them
+    size_t currentAnimationStep = 0;      // steps applied
+    MapScene* mapScene; // the items of the shown map, moved by each layout frame
+    CityListModel* cityModel; // cities of the current graph, for every city picker
+    LayoutWorker layoutWorker;
+    int layoutGeneration = 0;
 };
 #endif // MAINWINDOW_H
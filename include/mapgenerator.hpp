@@ -0,0 +1,77 @@
+#ifndef MAPGENERATOR_HPP
+#define MAPGENERATOR_HPP
+#include <cstdint>
+#include <functional>
+#include <string>
+using namespace std;
+
+// Synthetic maps for scale testing. Cities and edges are produced as a
+// stream of callbacks and only a row or two of the map is kept, so a tool
+// can write maps far larger than memory straight to a file. The same
+// options, seed included, always give the same map.
+//
+// Topologies:
+//   Grid       square lattice, 1 km apart
+//   Geometric  random points, joined when closer than a radius picked for
+//              the requested average degree
+//   ScaleFree  power law degrees (Chung-Lu, exponent 2.5) on a random tree
+//   Road       jittered lattice of local streets, some missing, crossed every
+//              8 blocks by faster arterials and every 32 by highways: planar,
+//              degree at most 4
+// Every topology is connected, so a map has exactly `components` connected
+// components, laid out side by side.
+class MapGenerator
+{
+public:
+    enum Topology { Grid, Geometric, ScaleFree, Road };
+    // Edge distances in km. Euclidean uses the city positions (times a small
+    // detour factor on roads); the others draw from a distribution:
+    // Uniform between a and b, Normal with mean a and deviation b (at least
+    // 0.001), Exponential with mean a.
+    struct Weights {
+        enum Kind { Euclidean, Uniform, Normal, Exponential };
+        Kind kind = Euclidean;
+        double a = 0, b = 0;
+    };
+    struct Options {
+        Topology topology = Road;
+        long long cities = 1000;  // over all components
+        int components = 1;
+        double degree = 0;        // average, for Geometric and ScaleFree; 0 = 6 and 4
+        Weights distance;
+        // Times are distance / speed in hours, the speed drawn from this range
+        // in km/h. Road uses the speeds of its road classes instead.
+        double minSpeed = 40, maxSpeed = 120;
+        uint64_t seed = 1;
+    };
+
+    // Called once per city, in id order, with its position in km. alone: the
+    // city is a component by itself, so no edge will name it.
+    using CityCallback = function<void(long long id, double x, double y, bool alone)>;
+    // Called once per undirected edge, in no particular order.
+    using EdgeCallback = function<void(long long u, long long v, double distance, double time)>;
+
+    explicit MapGenerator(const Options& options) : options(options) {}
+    // Streams the whole map. Callbacks may be empty.
+    void Run(const CityCallback& city, const EdgeCallback& edge);
+
+    // "grid", "geometric", "scalefree" or "road".
+    static bool ParseTopology(const string& text, Topology& topology);
+    // "euclidean", "uniform:MIN:MAX", "normal:MEAN:SD" or "exponential:MEAN".
+    static bool ParseWeights(const string& text, Weights& weights);
+
+private:
+    class Random;
+    // Each generates one component from id first and returns its width.
+    double grid(long long first, long long count, double x0, Random& random, bool road);
+    double geometric(long long first, long long count, double x0, Random& random);
+    double scaleFree(long long first, long long count, double x0, Random& random);
+    double distance(double length, Random& random) const;
+    void emit(long long u, long long v, double distance, double speed);
+
+    Options options;
+    CityCallback city;
+    EdgeCallback edge;
+};
+
+#endif // MAPGENERATOR_HPP
@@ -0,0 +1,99 @@
+#ifndef MAPSCENE_H
+#define MAPSCENE_H
+
+#include <QGraphicsPathItem>
+#include <QGraphicsScene>
+#include <QGraphicsTextItem>
+#include <QGraphicsView>
+#include <QHash>
+#include <QObject>
+#include "graph.hpp"
+#include "graphviewitems.hpp"
+#include "spatialindex.hpp"
+#include <functional>
+using namespace std;
+
+// Keeps one scene per map view in step with a graph, with level of detail.
+//
+// The view gets a single scene for its whole life. After edits, sync()
+// replays the graph's undo log since the last sync and only touches the
+// cities and edges it names. After a reset, an edit outside the log or the
+// undo of a large batch it reads the whole graph instead, diffed by city
+// name: it only creates items for new cities and deletes the items of removed
+// ones, and keeps the rest together with their highlight. All edges are one
+// EdgeBatch, so a changed edge costs no item at all.
+//
+// The wheel zooms and dragging pans. A click on an edge reports the edge, and
+// a click anywhere else the nearest city, found through a SpatialIndex over
+// the current positions; shift-dragging draws a lasso that selects the cities
+// inside it. How much is drawn depends on how far apart cities are on screen: names and edge labels only when there is room
+// to read them, single cities when they do not overlap, and below that one
+// circle per cluster of cities, which zooms in when clicked.
+class MapScene : public QObject
+{
+public:
+    explicit MapScene(QGraphicsView* view);
+
+    // Brings the scene in line with g; positions come with setPositions().
+    // Edge labels show times when byTime is set.
+    void sync(const Graph& g, bool byTime = false);
+    void setPositions(const vector<float>& x, const vector<float>& y);
+    void clear(); // deletes every city item and forgets the edges
+
+    void highlightCity(const QString& name, const QColor& color);
+    void highlightEdge(const QString& from, const QString& to, const QColor& color);
+    void resetColors();
+    // Current colors, to put them back later; invalid when not shown, and
+    // for an edge also while it has the default pen.
+    QColor cityColor(const QString& name) const;
+    QColor edgeColor(const QString& from, const QString& to) const;
+
+    // Nearest shown city within maxDistance scene units of pos, or "".
+    QString cityAt(const QPointF& pos, qreal maxDistance = numeric_limits<qreal>::infinity()) const;
+    QStringList citiesIn(const QPolygonF& area) const;
+
+    function<void(const QString&)> onCityClicked;
+    function<void(const QString&, const QString&)> onEdgeClicked; // its two cities
+    function<void(const QStringList&)> onLasso; // after the lasso selected its cities
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    static constexpr qreal LABEL_MIN_SPACING = 60; // screen pixels between cities
+    static constexpr qreal NODE_MIN_SPACING = 12;
+    static constexpr qreal CLUSTER_CELL = 40;      // screen pixels per cluster
+    static constexpr int CLICK_SLOP = 4;           // screen pixels a click may move and not be a drag
+    static constexpr qreal EDGE_CLICK_SLOP = 6;    // screen pixels from an edge that still hit it
+    static constexpr qreal CITY_RADIUS = 15;       // of a city's circle, in scene units
+    enum class Detail { Clusters, Cities, Labels };
+
+    struct CityItems {
+        CityNode* node;
+        QGraphicsTextItem* label;
+    };
+
+    void updateLevelOfDetail();
+    bool syncChanges(const Graph& g); // false if g has to be read in full
+    CityItems addCityItems(const QString& city);
+    EdgeBatch::Edge edgeItem(const Graph& g, int from, const Graph::Edge& e) const;
+
+    QGraphicsView* view;
+    QGraphicsScene* scene;
+    const Graph* shownGraph = nullptr; // the zoom is reset when this changes
+    Graph::LogPosition synced;         // of shownGraph at the last sync()
+    bool shownByTime = false;
+    QHash<QString, CityItems> cities;   // what the scene shows
+    QHash<QString, int> idByName;       // ids in the graph of the last sync()
+    vector<int> ids;                    // live city ids
+    vector<CityItems> byId;
+    EdgeBatch* edges;
+    ClusterLayer* clusters;
+    SpatialIndex cityIndex;             // by city id, follows setPositions()
+    QGraphicsPathItem* lasso = nullptr; // while shift-dragging
+    QPoint pressPos;                    // of the left button, in the viewport
+    qreal spacing = 0;                  // typical distance between cities, in scene units
+    Detail detail = Detail::Labels;
+};
+
+#endif // MAPSCENE_H
@@ -2,24 +2,76 @@
 #define PROGRAM_HPP
 
 #include "filehandler.hpp"
+#include "taskpool.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 using namespace std;
 class Program {
 public:
-    Program();
+    // The map file defaults to $WASALNEY_MAP, or filename.txt in the working
+    // directory. threads sizes the task pool; 0 means one per core. Without
+    // writeIndexes sidecars are still read but never written, so nothing is
+    // created next to the map file.
+    explicit Program(const string& mapFile = DefaultMapFile(), unsigned threads = 0, bool writeIndexes = true);
+    static string DefaultMapFile();
 
-    void loadGraphs();
-    void saveGraphs();
+    // On failure the reason is in f.lastError.
+    bool loadGraphs();
+    bool saveGraphs();
     bool addGraph(const string& name);
     bool deleteGraph(const string& name);
-    Graph* getGraphByName(const string& name);
+    // Imports a DIMACS .gr file (plus matching .time.gr and .co files if
+    // present) or a CSV/TSV edge list as a new graph named after the file.
+    bool importGraph(const string& path, string& error);
+    // Adds edges and cities pasted as text (see GraphImporter::ApplyEdgeList)
+    // to g as one undo step.
+    bool pasteEdges(const shared_ptr<Graph>& g, const string& text, string& error);
+    // Edits made by hand go between g->beginTransaction() and commitEdit(),
+    // which marks the map modified when anything changed; undo() and redo()
+    // step through those transactions.
+    bool commitEdit(const shared_ptr<Graph>& g);
+    bool undo(const shared_ptr<Graph>& g);
+    bool redo(const shared_ptr<Graph>& g);
+
+    // The latest published version of g, for reading on any thread while g
+    // is edited on this one: it never changes, so readers take no lock and
+    // never see half an edit. nullptr before g is first published. The
+    // functions above publish every edit they complete.
+    static shared_ptr<const Graph> snapshot(const shared_ptr<Graph>& g) { return atomic_load(&g->published); }
+    // Publishes g's current version unless a transaction is still open.
+    void publish(const shared_ptr<Graph>& g);
+        shared_ptr<Graph> getGraphByName(const string& name);
     void setCurrentGraph(const string& name);
 
+    // Uses the graph's sidecar index when it is still valid, otherwise
+    // rebuilds it on the task pool and saves it next to the map file (if
+    // writeIndexes).
+    void loadIndex(const shared_ptr<Graph>& g);
+    void rebuildIndexInBackground(const shared_ptr<Graph>& g);
+    // Caches a finished layout on the graph for every view, and writes it to
+    // the sidecar right away when the graph matches the map file on disk.
+    void storeLayout(const shared_ptr<Graph>& g, shared_ptr<const Graph::LayoutPositions> layout);
+
+    string mapFile;
     Filehandler f;
-     vector<Graph> graphs;
-    Graph* currentGraph = nullptr;
+    // Single graph store shared with Filehandler; graphs are heap-allocated so
+    // currentGraph stays valid when the vector grows or another graph is erased.
+    vector<shared_ptr<Graph>> graphs;
+    shared_ptr<Graph> currentGraph;
      bool isModified = false;
+    const bool writeIndexes;
+
+private:
+    mutex indexFileMutex;
+
+public:
+    // Worker threads for all parallel work: queries, index builds, layouts
+    // and tasks from the GUI. Declared last so it finishes its tasks, which
+    // may use the members above, before they are destroyed.
+    TaskPool pool;
 };
 
 #endif // PROGRAM_HPP
@@ -0,0 +1,117 @@
+#ifndef QUERYSTATS_HPP
+#define QUERYSTATS_HPP
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+using namespace std;
+
+// Work done by one route query, for telling why it was slow. Counted only
+// when built with WASALNEY_QUERY_STATS (qmake CONFIG+=query_stats); without
+// it the counting calls below are empty and compile away, and every field
+// stays zero.
+struct QueryStats {
+#ifdef WASALNEY_QUERY_STATS
+    static const bool ENABLED = true;
+#else
+    static const bool ENABLED = false;
+#endif
+
+    // "dijkstra", "components" when the component index proved there is no
+    // path, or "unknown city".
+    const char* algorithm = "";
+    uint64_t settled = 0;        // cities taken from the heap for good
+    uint64_t relaxed = 0;        // edges that improved a city's cost
+    uint64_t pushes = 0, pops = 0;
+    uint64_t peakQueue = 0;      // most entries on the heap at once
+    double micros = 0;           // wall time of the whole query
+
+    void settle() { if (ENABLED) settled++; }
+    void relax() { if (ENABLED) relaxed++; }
+    void push(size_t queueSize)
+    {
+        if (!ENABLED) return;
+        pushes++;
+        peakQueue = max<uint64_t>(peakQueue, queueSize);
+    }
+    void pop() { if (ENABLED) pops++; }
+    // Times the query: stop(start()) stores the time in between.
+    chrono::steady_clock::time_point start() const
+    {
+        return ENABLED ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+    }
+    void stop(chrono::steady_clock::time_point started)
+    {
+        if (ENABLED) micros = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count();
+    }
+
+    string summary() const
+    {
+        char text[160];
+        snprintf(text, sizeof text, "%s: %llu settled, %llu relaxed, %llu pushes, %llu pops, peak queue %llu, %.3f ms",
+                 algorithm, (unsigned long long)settled, (unsigned long long)relaxed, (unsigned long long)pushes,
+                 (unsigned long long)pops, (unsigned long long)peakQueue, micros / 1000);
+        return text;
+    }
+};
+
+// Power of two histograms of every counter over many queries, in constant
+// memory, for the CLI's --stats dump.
+class QueryStatsHistograms
+{
+public:
+    static const int BUCKETS = 64; // bucket b holds values in [2^(b-1), 2^b), b = 0 holds 0
+
+    void add(const QueryStats& s)
+    {
+        queries++;
+        algorithms[s.algorithm]++;
+        counters[SETTLED].add(s.settled);
+        counters[RELAXED].add(s.relaxed);
+        counters[PUSHES].add(s.pushes);
+        counters[POPS].add(s.pops);
+        counters[PEAK_QUEUE].add(s.peakQueue);
+        counters[MICROS].add((uint64_t)s.micros);
+    }
+
+    // Tab separated: one row per non empty bucket, then queries per algorithm.
+    void write(FILE* out) const
+    {
+        static const char* const NAMES[COUNTERS] = {"settled", "relaxed", "pushes", "pops", "peak_queue", "micros"};
+        fprintf(out, "counter\tfrom\tto\tqueries\n");
+        for (int c = 0; c < COUNTERS; c++) {
+            for (int b = 0; b < BUCKETS; b++) {
+                if (!counters[c].buckets[b]) continue;
+                uint64_t from = b ? uint64_t(1) << (b - 1) : 0;
+                uint64_t to = b ? (uint64_t(1) << (b - 1)) * 2 - 1 : 0;
+                fprintf(out, "%s\t%llu\t%llu\t%llu\n", NAMES[c], (unsigned long long)from,
+                        (unsigned long long)to, (unsigned long long)counters[c].buckets[b]);
+            }
+        }
+        fprintf(out, "\nalgorithm\tqueries\n");
+        for (const auto& [name, count] : algorithms) {
+            fprintf(out, "%s\t%llu\n", name.c_str(), (unsigned long long)count);
+        }
+    }
+
+    uint64_t queries = 0;
+
+private:
+    enum { SETTLED, RELAXED, PUSHES, POPS, PEAK_QUEUE, MICROS, COUNTERS };
+    struct Histogram {
+        uint64_t buckets[BUCKETS] = {};
+        void add(uint64_t value)
+        {
+            int b = 0;
+            while (b < BUCKETS - 1 && value >> b) b++;
+            buckets[b]++;
+        }
+    };
+    Histogram counters[COUNTERS];
+    map<string, uint64_t> algorithms;
+};
+
+#endif // QUERYSTATS_HPP
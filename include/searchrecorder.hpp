@@ -0,0 +1,56 @@
+#ifndef SEARCHRECORDER_HPP
+#define SEARCHRECORDER_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Visitor for Graph::Dijkstra that keeps the latest settle and relax events
+// in a fixed ring buffer, for replaying how the frontier grew.
+//
+// Recording is a store and an increment per event. When a search produces
+// more events than fit, the oldest ones are overwritten; dropped() says how
+// many.
+class SearchRecorder
+{
+public:
+    struct Event {
+        int city;
+        int from : 31;          // -1 for the start
+        unsigned settled : 1;   // settle, else relax
+        float cost;
+    };
+
+    explicit SearchRecorder(size_t capacity = size_t(1) << 16)
+    {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        ring.resize(size);
+        mask = size - 1;
+    }
+
+    void settle(int city, int from, double cost) { push(city, from, true, cost); }
+    void relax(int city, int from, double cost) { push(city, from, false, cost); }
+
+    void clear() { written = 0; }
+    size_t size() const { return written < ring.size() ? (size_t)written : ring.size(); }
+    uint64_t dropped() const { return written - size(); }
+    // Oldest retained event first.
+    const Event& operator[](size_t i) const { return ring[(written - size() + i) & mask]; }
+
+private:
+    void push(int city, int from, bool settled, double cost)
+    {
+        Event& e = ring[written++ & mask];
+        e.city = city;
+        e.from = from;
+        e.settled = settled;
+        e.cost = (float)cost;
+    }
+
+    vector<Event> ring;
+    size_t mask = 0;
+    uint64_t written = 0;
+};
+
+#endif // SEARCHRECORDER_HPP
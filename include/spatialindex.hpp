@@ -0,0 +1,50 @@
+#ifndef SPATIALINDEX_HPP
+#define SPATIALINDEX_HPP
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Uniform grid over laid out city positions, for picking cities on a map.
+//
+// Cells are hashed, so positions may go anywhere; the cell size is chosen in
+// build() for about two cities per cell. update() moves a city between cells
+// only when it crosses a cell border, so feeding it every layout frame is
+// cheap.
+class SpatialIndex
+{
+public:
+    // Indexes ids at (x[id], y[id]).
+    void build(const vector<float>& x, const vector<float>& y, const vector<int>& ids);
+    void update(int id, float x, float y); // inserts or moves
+    void remove(int id);
+    void clear();
+    int size() const { return count; }
+    bool contains(int id) const { return id >= 0 && id < (int)slot.size() && slot[id] >= 0; }
+
+    // Closest city within maxDistance, -1 if none.
+    int nearest(float x, float y, float maxDistance = numeric_limits<float>::infinity()) const;
+    vector<int> withinRadius(float x, float y, float radius) const;
+    vector<int> inRect(float minX, float minY, float maxX, float maxY) const;
+    // Cities inside the closed polygon (px[i], py[i]), e.g. a lasso.
+    vector<int> inPolygon(const vector<float>& px, const vector<float>& py) const;
+
+private:
+    int cellOf(float v) const { return (int)floor(v / cellSize); }
+    static uint64_t key(int cx, int cy) { return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy); }
+    const vector<int>* cell(int cx, int cy) const;
+    void insert(int id, float x, float y);
+    void unlink(int id);
+
+    float cellSize = 1.0f;
+    vector<float> xs, ys;       // by id
+    vector<int> slot;           // index of the id in its cell, -1 if not indexed
+    unordered_map<uint64_t, vector<int>> cells;
+    int count = 0;
+    // Cells that ever held a city since build(); bounds the nearest() search.
+    int minCellX = 0, maxCellX = -1, minCellY = 0, maxCellY = -1;
+};
+
+#endif // SPATIALINDEX_HPP
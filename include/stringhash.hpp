@@ -0,0 +1,19 @@
+#ifndef STRINGHASH_HPP
+#define STRINGHASH_HPP
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+using namespace std;
+
+// Hash for string keyed containers that also takes string_view and const
+// char*, so find() needs no temporary string. Use with equal_to<>.
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(string_view s) const { return hash<string_view>{}(s); }
+};
+
+template <typename T>
+using StringMap = unordered_map<string, T, StringHash, equal_to<>>;
+
+#endif // STRINGHASH_HPP
@@ -0,0 +1,81 @@
+#ifndef TASKPOOL_HPP
+#define TASKPOOL_HPP
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Asks running work to stop. Copies share one flag, so the submitter keeps a
+// copy and cancels, and the work polls cancelled() at convenient points.
+class CancelToken
+{
+public:
+    CancelToken() : flag(make_shared<atomic<bool>>(false)) {}
+    void cancel() const { flag->store(true); }
+    bool cancelled() const { return flag->load(memory_order_relaxed); }
+
+private:
+    shared_ptr<atomic<bool>> flag;
+};
+
+// The one set of worker threads for parallel graph work, owned by Program,
+// so queries, index builds and layouts share the cores instead of each
+// starting threads of their own.
+//
+// Every worker has its own deque per priority. Tasks submitted by a worker go
+// on the back of its deque and it takes them back LIFO, while tasks from
+// other threads go on a shared queue. An idle worker takes its own work
+// first, then the shared queue, then steals from the front of the other
+// workers' deques. Interactive work anywhere is taken before any background
+// work; a task already running is never preempted.
+//
+// Tasks must not throw. The destructor runs every task already submitted,
+// then joins the workers.
+class TaskPool
+{
+public:
+    enum Priority { Interactive, Background };
+
+    // 0 threads means one per core.
+    explicit TaskPool(unsigned threads = 0);
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    unsigned size() const { return (unsigned)queues.size() - 1; }
+    void submit(function<void()> task, Priority priority = Background);
+
+    // Calls body(from, to) on consecutive subranges of [begin, end), each
+    // at most grain long (0 picks a few per worker), on the workers and the
+    // calling thread, and returns once all have finished. May be called from
+    // a task. Subranges not started when token is cancelled are skipped; the
+    // first exception a body throws stops the rest and is rethrown here.
+    void parallelFor(int begin, int end, const function<void(int, int)>& body,
+                     Priority priority = Interactive, const CancelToken& token = CancelToken(), int grain = 0);
+
+private:
+    static const int PRIORITIES = 2;
+    struct Queue {
+        mutex lock;
+        deque<function<void()>> tasks[PRIORITIES];
+    };
+
+    void run(int self);
+    bool take(int self, function<void()>& task);
+    bool popFront(Queue& queue, int priority, function<void()>& task);
+
+    // One per worker, then the shared queue. Filled before the workers start.
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+    atomic<int> queued{0};
+    mutex sleepLock;
+    condition_variable wake;
+    bool stopping = false;
+};
+
+#endif // TASKPOOL_HPP
@@ -0,0 +1,63 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+// Records timed spans and writes them as Chrome trace_event JSON, for
+// chrome://tracing or ui.perfetto.dev:
+//
+//     void Program::loadGraphs() {
+//         TRACE_SPAN("Program::loadGraphs");
+//         ...
+//
+// Tracing is off until Start() (or StartFromEnvironment() with
+// $WASALNEY_TRACE set); until then a span costs one relaxed load. Each
+// thread appends to its own buffer without locking, and the file is written
+// by Flush() and again at exit. Span names must be string literals.
+class Tracer
+{
+public:
+    // Records from now on and writes the trace to path at exit.
+    static void Start(const string& path);
+    // Start($WASALNEY_TRACE) if it is set; true if tracing.
+    static bool StartFromEnvironment();
+    static bool Enabled() { return enabled.load(memory_order_relaxed); }
+    // Writes every span finished so far; false if the file cannot be written.
+    static bool Flush();
+
+    // Nanoseconds on the trace clock.
+    static uint64_t Now()
+    {
+        return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void Record(const char* name, uint64_t start, uint64_t end);
+
+private:
+    static atomic<bool> enabled;
+};
+
+// Times its own lifetime when tracing is on.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name) : name(Tracer::Enabled() ? name : nullptr), start(this->name ? Tracer::Now() : 0) {}
+    ~TraceSpan()
+    {
+        if (name) Tracer::Record(name, start, Tracer::Now());
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif // TRACER_HPP
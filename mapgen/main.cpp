@@ -0,0 +1,285 @@
+// wasalney_mapgen: writes synthetic maps for scale testing.
+//
+//   wasalney_mapgen [options] <output file>
+//
+// The map is streamed to the file as it is generated (see mapgenerator.hpp),
+// so outputs of many GB need only a few MB of memory. Two formats:
+//   text    the filename.txt format, one graph; "-" writes it to stdout
+//   dimacs  FILE.gr with distances, FILE.time.gr with times and FILE.co with
+//           positions, all read by File > Import. Much faster to load than
+//           text: cities are numbered, so nothing is looked up by name.
+//           DIMACS numbers are integers, so distances and positions are in
+//           metres and times in seconds; the scale in each file's c line
+//           lets File > Import show km and hours again.
+// City names are 1..N in both formats.
+#include "mapgenerator.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// fwrite in large blocks with numbers formatted in place; iostreams are
+// several times slower for output dominated by numbers.
+class Writer
+{
+public:
+    bool open(const string& path)
+    {
+        file = path == "-" ? stdout : fopen(path.c_str(), "wb");
+        return file != nullptr;
+    }
+    ~Writer() { close(); }
+
+    void text(const char* s) { text(s, strlen(s)); }
+    void text(const char* s, size_t n)
+    {
+        if (used + n > SIZE) flush();
+        if (n > SIZE) {
+            if (fwrite(s, 1, n, file) != n) ok = false;
+            return;
+        }
+        memcpy(buffer + used, s, n);
+        used += n;
+    }
+    void number(long long n)
+    {
+        if (used + 32 > SIZE) flush();
+        used = to_chars(buffer + used, buffer + SIZE, n).ptr - buffer;
+    }
+    // Rounded to 0.001, which is a metre or a few seconds, and keeps files short.
+    void number(double d)
+    {
+        if (used + 32 > SIZE) flush();
+        used = to_chars(buffer + used, buffer + SIZE, round(d * 1000) / 1000, chars_format::fixed, 3).ptr - buffer;
+        while (buffer[used - 1] == '0') used--;
+        if (buffer[used - 1] == '.') used--;
+    }
+    void put(char c)
+    {
+        if (used == SIZE) flush();
+        buffer[used++] = c;
+    }
+
+    bool close()
+    {
+        if (!file) return ok;
+        flush();
+        if (file == stdout) ok = fflush(file) == 0 && ok;
+        else ok = fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    void flush()
+    {
+        if (used && fwrite(buffer, 1, used, file) != used) ok = false;
+        used = 0;
+    }
+
+    static const size_t SIZE = 1 << 20;
+    vector<char> storage = vector<char>(SIZE);
+    char* buffer = storage.data();
+    size_t used = 0;
+    FILE* file = nullptr;
+    bool ok = true;
+};
+
+void printUsage()
+{
+    cerr << "Usage: wasalney_mapgen [options] <output file>\n"
+            "  -t, --topology T     grid, geometric, scalefree or road (default: road)\n"
+            "  -n, --cities N       number of cities (default: 1000)\n"
+            "  -c, --components N   connected components (default: 1)\n"
+            "      --degree D       average degree of geometric (6) and scalefree (4) maps\n"
+            "      --distance W     euclidean, uniform:MIN:MAX, normal:MEAN:SD or\n"
+            "                       exponential:MEAN, in km (default: euclidean)\n"
+            "      --speed MIN:MAX  speed range in km/h for the times (default: 40:120)\n"
+            "      --seed N         random seed (default: 1)\n"
+            "      --name NAME      graph name in text output (default: Synthetic)\n"
+            "  -f, --format F       text or dimacs (default: dimacs for .gr files, else text)\n"
+            "Output \"-\" writes text to stdout.\n";
+}
+
+bool parseSpeed(const string& text, MapGenerator::Options& options)
+{
+    size_t colon = text.find(':');
+    if (colon == string::npos) return false;
+    char* end = nullptr;
+    double a = strtod(text.c_str(), &end);
+    if (end != text.c_str() + colon) return false;
+    double b = strtod(text.c_str() + colon + 1, &end);
+    if (*end || !(a > 0) || !(b >= a)) return false;
+    options.minSpeed = a;
+    options.maxSpeed = b;
+    return true;
+}
+
+bool writeText(MapGenerator& generator, const string& path, const string& name)
+{
+    Writer out;
+    if (!out.open(path)) return false;
+    out.text("1\n");
+    out.text(name.c_str(), name.size());
+    out.put('\n');
+    // Cities with no edges are only known by their ISOLATED lines, which are
+    // written as they come, between the edges.
+    generator.Run(
+        [&](long long id, double, double, bool alone) {
+            if (!alone) return;
+            out.number(id + 1);
+            out.text(" ISOLATED 0 0\n");
+        },
+        [&](long long u, long long v, double distance, double time) {
+            out.number(u + 1);
+            out.put(' ');
+            out.number(v + 1);
+            out.put(' ');
+            out.number(distance);
+            out.put(' ');
+            out.number(time);
+            out.put('\n');
+        });
+    out.text("#\n");
+    return out.close();
+}
+
+// DIMACS units per km and per hour; a weight rounds to at least 1.
+const double METRES_PER_KM = 1000, SECONDS_PER_HOUR = 3600;
+
+long long weight(double value, double scale)
+{
+    return max(1LL, llround(value * scale));
+}
+
+void arc(Writer& out, long long u, long long v, long long weight)
+{
+    out.text("a ");
+    out.number(u + 1);
+    out.put(' ');
+    out.number(v + 1);
+    out.put(' ');
+    out.number(weight);
+    out.put('\n');
+}
+
+// The .gr header needs the arc count, so the map is generated twice (the
+// seed makes both runs the same): first for the positions and the count,
+// then for the arcs, each edge as an arc in both directions.
+bool writeDimacs(MapGenerator& generator, const string& path, long long cities)
+{
+    string stem = path.size() > 3 && path.compare(path.size() - 3, 3, ".gr") == 0 ? path.substr(0, path.size() - 3) : path;
+    long long edges = 0;
+    {
+        Writer co;
+        if (!co.open(stem + ".co")) return false;
+        co.text("c wasalney_mapgen positions in metres (km x 1000)\np aux sp co ");
+        co.number(cities);
+        co.put('\n');
+        generator.Run(
+            [&](long long id, double x, double y, bool) {
+                co.text("v ");
+                co.number(id + 1);
+                co.put(' ');
+                co.number(llround(x * METRES_PER_KM));
+                co.put(' ');
+                co.number(llround(y * METRES_PER_KM));
+                co.put('\n');
+            },
+            [&](long long, long long, double, double) { edges++; });
+        if (!co.close()) return false;
+    }
+
+    Writer distance, time;
+    if (!distance.open(stem + ".gr") || !time.open(stem + ".time.gr")) return false;
+    for (Writer* out : {&distance, &time}) {
+        out->text(out == &distance ? "c wasalney_mapgen distances in metres (km x 1000)\np sp "
+                                   : "c wasalney_mapgen times in seconds (hours x 3600)\np sp ");
+        out->number(cities);
+        out->put(' ');
+        out->number(2 * edges);
+        out->put('\n');
+    }
+    generator.Run(nullptr, [&](long long u, long long v, double km, double hours) {
+        long long d = weight(km, METRES_PER_KM), t = weight(hours, SECONDS_PER_HOUR);
+        arc(distance, u, v, d);
+        arc(distance, v, u, d);
+        arc(time, u, v, t);
+        arc(time, v, u, t);
+    });
+    bool ok = distance.close();
+    return time.close() && ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    MapGenerator::Options options;
+    string output, format, name = "Synthetic";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << "Missing value for " << arg << "\n";
+                exit(2);
+            }
+            return argv[++i];
+        };
+        bool ok = true;
+        if (arg == "-t" || arg == "--topology") ok = MapGenerator::ParseTopology(value(), options.topology);
+        else if (arg == "-n" || arg == "--cities") options.cities = atoll(value().c_str());
+        else if (arg == "-c" || arg == "--components") options.components = atoi(value().c_str());
+        else if (arg == "--degree") options.degree = atof(value().c_str());
+        else if (arg == "--distance") ok = MapGenerator::ParseWeights(value(), options.distance);
+        else if (arg == "--speed") ok = parseSpeed(value(), options);
+        else if (arg == "--seed") options.seed = strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--name") name = value();
+        else if (arg == "-f" || arg == "--format") format = value();
+        else if (arg == "-h" || arg == "--help") { printUsage(); return 0; }
+        else if (arg.size() > 1 && arg[0] == '-') { printUsage(); return 2; }
+        else output = arg;
+        if (!ok) {
+            cerr << "Invalid value for " << arg << "\n";
+            return 2;
+        }
+    }
+    if (output.empty()) {
+        printUsage();
+        return 2;
+    }
+    // The app numbers cities with int.
+    if (options.cities < 1 || options.cities > INT_MAX || options.components < 1 || options.degree < 0) {
+        cerr << "Cities must be 1 to " << INT_MAX << ", components at least 1\n";
+        return 2;
+    }
+    if (format.empty()) format = output.size() > 3 && output.compare(output.size() - 3, 3, ".gr") == 0 ? "dimacs" : "text";
+    if (format != "text" && (format != "dimacs" || output == "-")) {
+        printUsage();
+        return 2;
+    }
+    if (name.empty() || name == "#" || name.find('\n') != string::npos) {
+        cerr << "Invalid graph name\n";
+        return 2;
+    }
+
+    MapGenerator generator(options);
+    bool ok = format == "text" ? writeText(generator, output, name) : writeDimacs(generator, output, options.cities);
+    if (!ok) {
+        cerr << "Failed to write " << output << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    return 0;
+}
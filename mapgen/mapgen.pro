@@ -0,0 +1,10 @@
+# wasalney_mapgen: synthetic maps for scale testing; see main.cpp.
+TEMPLATE = app
+TARGET = wasalney_mapgen
+CONFIG += console c++20
+CONFIG -= qt app_bundle
+
+include(../core/link_core.pri)
+
+SOURCES += \
+    main.cpp
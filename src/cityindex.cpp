@@ -0,0 +1,182 @@
+#include "cityindex.hpp"
+#include <algorithm>
+
+string CityIndex::fold(const string& s)
+{
+    string key = s;
+    for (char& c : key) {
+        if (c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+    }
+    return key;
+}
+
+vector<uint32_t> CityIndex::trigrams(const string& key)
+{
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= key.size(); i++) grams.push_back(trigram(key.data() + i));
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+void CityIndex::build(const vector<string>& list)
+{
+    clear();
+    names.reserve(list.size());
+    keys.reserve(list.size());
+    slotOf.reserve(list.size());
+    for (const string& n : list) {
+        if (n.empty() || slotOf.count(n)) continue;
+        int slot = (int)names.size();
+        names.push_back(n);
+        keys.push_back(fold(n));
+        slotOf.emplace(n, slot);
+        for (uint32_t g : trigrams(keys[slot])) postings[g].push_back(slot);
+        order.push_back(slot);
+    }
+    sort(order.begin(), order.end(), [this](int a, int b) {
+        return keys[a] != keys[b] ? keys[a] < keys[b] : names[a] < names[b];
+    });
+    rowOf.assign(names.size(), -1);
+    renumber(0);
+}
+
+// The shift of order after an insert or remove already costs O(rows), so
+// keeping rowOf exact costs no more and saves a search per lookup.
+void CityIndex::renumber(int fromRow)
+{
+    for (int r = fromRow; r < (int)order.size(); r++) rowOf[order[r]] = r;
+}
+
+void CityIndex::clear()
+{
+    names.clear();
+    keys.clear();
+    freeSlots.clear();
+    order.clear();
+    rowOf.clear();
+    slotOf.clear();
+    postings.clear();
+}
+
+int CityIndex::lowerBound(const string& key, const string& name) const
+{
+    auto it = lower_bound(order.begin(), order.end(), 0, [&](int slot, int) {
+        return keys[slot] != key ? keys[slot] < key : names[slot] < name;
+    });
+    return int(it - order.begin());
+}
+
+int CityIndex::row(string_view name) const
+{
+    auto it = slotOf.find(name);
+    return it == slotOf.end() ? -1 : rowOf[it->second];
+}
+
+int CityIndex::insertRow(const string& name) const
+{
+    return lowerBound(fold(name), name);
+}
+
+int CityIndex::insert(const string& name)
+{
+    if (name.empty() || slotOf.count(name)) return -1;
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        names[slot] = name;
+        keys[slot] = fold(name);
+    } else {
+        slot = (int)names.size();
+        names.push_back(name);
+        keys.push_back(fold(name));
+        rowOf.push_back(-1);
+    }
+    slotOf.emplace(name, slot);
+    for (uint32_t g : trigrams(keys[slot])) postings[g].push_back(slot);
+
+    int r = lowerBound(keys[slot], name);
+    order.insert(order.begin() + r, slot);
+    renumber(r);
+    return r;
+}
+
+int CityIndex::remove(const string& name)
+{
+    auto it = slotOf.find(name);
+    if (it == slotOf.end()) return -1;
+    int slot = it->second;
+    int r = rowOf[slot];
+    order.erase(order.begin() + r);
+    renumber(r);
+    rowOf[slot] = -1;
+
+    for (uint32_t g : trigrams(keys[slot])) {
+        vector<int>& list = postings[g];
+        auto at = find(list.begin(), list.end(), slot);
+        if (at != list.end()) {
+            *at = list.back();
+            list.pop_back();
+        }
+        if (list.empty()) postings.erase(g);
+    }
+    slotOf.erase(it);
+    names[slot].clear();
+    keys[slot].clear();
+    freeSlots.push_back(slot);
+    return r;
+}
+
+pair<int, int> CityIndex::prefixRows(const string& prefix) const
+{
+    const string key = fold(prefix);
+    auto first = lower_bound(order.begin(), order.end(), 0, [&](int slot, int) {
+        return keys[slot] < key;
+    });
+    auto last = upper_bound(first, order.end(), 0, [&](int, int slot) {
+        return keys[slot].compare(0, key.size(), key) > 0;
+    });
+    return {int(first - order.begin()), int(last - order.begin())};
+}
+
+vector<int> CityIndex::search(const string& text, int limit) const
+{
+    vector<int> rows;
+    if (limit <= 0) return rows;
+    auto [first, last] = prefixRows(text);
+    for (int r = first; r < last && (int)rows.size() < limit; r++) rows.push_back(r);
+
+    const string key = fold(text);
+    if (key.size() < 3 || (int)rows.size() >= limit) return rows;
+
+    // Only names with the query's rarest trigram can contain it.
+    const vector<int>* rarest = nullptr;
+    for (uint32_t g : trigrams(key)) {
+        auto it = postings.find(g);
+        if (it == postings.end()) return rows;
+        if (!rarest || it->second.size() < rarest->size()) rarest = &it->second;
+    }
+    vector<int> more;
+    auto matches = [&](int slot) { // prefix matches are listed already
+        const string& k = keys[slot];
+        return k.compare(0, key.size(), key) != 0 && k.find(key) != string::npos;
+    };
+    if ((double)rarest->size() * rarest->size() > (double)limit * size()) {
+        // Common trigram: matches are dense, so walking the rows reaches
+        // limit of them sooner than checking every candidate.
+        for (int r = 0; r < size() && (int)(rows.size() + more.size()) < limit; r++) {
+            if (matches(order[r])) more.push_back(r);
+        }
+    } else {
+        for (int slot : *rarest) {
+            if (matches(slot)) more.push_back(rowOf[slot]);
+        }
+    }
+    sort(more.begin(), more.end());
+    for (int r : more) {
+        if ((int)rows.size() >= limit) break;
+        rows.push_back(r);
+    }
+    return rows;
+}
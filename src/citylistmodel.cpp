@@ -0,0 +1,87 @@
+#include "citylistmodel.h"
+#include "cityname.h"
+#include <QCompleter>
+#include <QLineEdit>
+#include <QListView>
+#include <QStringListModel>
+
+CityListModel::CityListModel(QObject* parent)
+    : QAbstractListModel(parent)
+{
+}
+
+void CityListModel::setGraph(const Graph* g)
+{
+    beginResetModel();
+    if (g) cities.build(g->getAllCities());
+    else cities.clear();
+    endResetModel();
+}
+
+void CityListModel::cityAdded(const QString& name)
+{
+    const string city = name.toStdString();
+    if (cities.row(city) >= 0) return;
+    const int row = cities.insertRow(city);
+    beginInsertRows(QModelIndex(), row, row);
+    cities.insert(city);
+    endInsertRows();
+}
+
+void CityListModel::cityRemoved(const QString& name)
+{
+    const string city = name.toStdString();
+    const int row = cities.row(city);
+    if (row < 0) return;
+    beginRemoveRows(QModelIndex(), row, row);
+    cities.remove(city);
+    endRemoveRows();
+}
+
+int CityListModel::rowOf(const QString& name) const
+{
+    return cities.row(CityName(name));
+}
+
+QStringList CityListModel::match(const QString& text, int limit) const
+{
+    QStringList names;
+    for (int row : cities.search(text.toStdString(), limit)) {
+        names.append(QString::fromStdString(cities.name(row)));
+    }
+    return names;
+}
+
+void CityListModel::attach(QComboBox* box)
+{
+    box->setModel(this);
+    box->setEditable(true);
+    box->setInsertPolicy(QComboBox::NoInsert);
+    // Sizing the box or its popup to the longest name would visit every row.
+    box->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+    if (QListView* list = qobject_cast<QListView*>(box->view())) list->setUniformItemSizes(true);
+
+    // The popup lists what CityIndex found, so the completer does no
+    // filtering of its own.
+    QStringListModel* matches = new QStringListModel(box);
+    QCompleter* completer = new QCompleter(matches, box);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    box->setCompleter(completer);
+    connect(box->lineEdit(), &QLineEdit::textEdited, box, [this, matches, completer](const QString& text) {
+        matches->setStringList(text.isEmpty() ? QStringList() : match(text, MATCH_LIMIT));
+        if (!text.isEmpty()) completer->complete();
+    });
+    box->setCurrentIndex(-1);
+}
+
+int CityListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : cities.size();
+}
+
+QVariant CityListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= cities.size()) return QVariant();
+    if (role != Qt::DisplayRole && role != Qt::EditRole) return QVariant();
+    return QString::fromStdString(cities.name(index.row()));
+}
@@ -1,16 +1,24 @@
 #include "exploremap.h"
 #include "ui_exploremap.h"
-#include"graphviewitems.hpp"
 #include<QMessageBox>
-#include <QGraphicsTextItem>
-#include <set>
+#include "cityname.h"
+#include "guitask.h"
+#include "tracer.hpp"
 
-ExploreMap::ExploreMap(Program* program, QWidget* parent)
-    : QDialog(parent), ui(new Ui::ExploreMap), program(program) {
+ExploreMap::ExploreMap(Program* program, CityListModel* cities, QWidget* parent)
+    : QDialog(parent), ui(new Ui::ExploreMap), program(program), cities(cities), layoutWorker(program->pool) {
     ui->setupUi(this);
+    mapScene = new MapScene(ui->visualizePath);
+    replayTimer = new QTimer(this);
+    connect(replayTimer, &QTimer::timeout, this, &ExploreMap::replayStep);
     ui->label->setText(QString::fromStdString(program->currentGraph->name));
     populateComboBoxes();
 
+    // Clicking the map picks the source, then the destination, and routes.
+    mapScene->onCityClicked = [this](const QString& city) { pickCity(city); };
+    mapScene->onEdgeClicked = [this](const QString& from, const QString& to) { showEdge(from, to); };
+    showMap('d');
+
     // Set focus border style for all widgets inside this form
     this->setStyleSheet(R"(
         QWidget:focus {
@@ -23,15 +31,37 @@ ExploreMap::ExploreMap(Program* program, QWidget* parent)
 void ExploreMap::populateComboBoxes() {
     if (!program->currentGraph) return;
 
-    const auto& cities = program->currentGraph->getAllCities();
+    cities->attach(ui->city1);
+    cities->attach(ui->city2);
+}
+
+void ExploreMap::pickCity(const QString& city) {
+    if (ui->city1->currentIndex() < 0 || ui->city2->currentIndex() >= 0) {
+        ui->city1->setCurrentIndex(cities->rowOf(city));
+        ui->city2->setCurrentIndex(-1);
+        replayTimer->stop();
+        mapScene->resetColors();
+        mapScene->highlightCity(city, Qt::yellow);
+        ui->path->setText("From " + city + ", click the destination.");
+        return;
+    }
 
-    for (const auto& city : cities) {
-        ui->city1->addItem(QString::fromStdString(city));
-        ui->city2->addItem(QString::fromStdString(city));
+    ui->city2->setCurrentIndex(cities->rowOf(city));
+    if (!ui->distance_rad->isChecked() && !ui->time_rad->isChecked()) {
+        ui->distance_rad->setChecked(true);
     }
+    on_findPath_clicked();
+}
 
-    ui->city1->setCurrentIndex(-1);
-    ui->city2->setCurrentIndex(-1);
+void ExploreMap::showEdge(const QString& from, const QString& to) {
+    const Graph& g = *program->currentGraph;
+    int u = g.cityId(CityName(from)), v = g.cityId(CityName(to));
+    const Graph::Edge* edge = u >= 0 && v >= 0 ? g.findEdge(u, v) : nullptr;
+    if (!edge) return;
+    replayTimer->stop();
+    mapScene->resetColors();
+    mapScene->highlightEdge(from, to, Qt::yellow);
+    ui->path->setText(QString("%1 - %2: %3 Km, %4 hrs").arg(from, to).arg(edge->distance).arg(edge->time));
 }
 
 void ExploreMap::on_findPath_clicked() {
@@ -50,50 +80,96 @@ void ExploreMap::on_findPath_clicked() {
         return;
     }
 
-    vector<string> pathResult;
-    if (ui->distance_rad->isChecked()){
-        auto shortestPath = program->currentGraph->DijkstraDistance(city1.toStdString(), city2.toStdString());
-        if (shortestPath.path.empty()) {
-            ui->path->setText("No path found.");
-            return;
-        }
-
-        for (size_t i = 0; i < shortestPath.path.size(); ++i) {
-            pathResult.push_back(shortestPath.path[i]);
-            if (i + 1 < shortestPath.path.size()) {
-                pathResult.push_back("-->");
+    // The search runs on the pool against a snapshot, so a long one does not
+    // freeze the dialog; a newer search or an edit discards its result.
+    const bool byTime = ui->time_rad->isChecked();
+    shared_ptr<Graph> current = program->currentGraph;
+    shared_ptr<const Graph> graph = Program::snapshot(current);
+    if (!graph || graph->version != current->version) graph = current->snapshot();
+    string from{string_view(CityName(city1))}, to{string_view(CityName(city2))};
+    searchToken.cancel();
+    searchToken = CancelToken();
+    ui->path->setText("Searching...");
+    runTask(program->pool, this, searchToken,
+        [graph, from, to, byTime](const CancelToken&) {
+            // Room for every event the search can make, a settle per city and
+            // a relax per directed edge, so the replay starts at the source.
+            size_t events = graph->idCount();
+            for (const auto& edges : graph->adj) events += edges.size();
+            pair<Graph::PathResult, SearchRecorder> search(Graph::PathResult(),
+                                                           SearchRecorder(min(events, MAX_REPLAY_EVENTS)));
+            search.first = graph->Dijkstra(from, to, byTime, search.second);
+            return search;
+        },
+        [this, current, version = graph->version, byTime](pair<Graph::PathResult, SearchRecorder> search) {
+            if (program->currentGraph != current || current->version != version) return;
+            recorder = std::move(search.second);
+            const Graph::PathResult& shortestPath = search.first;
+            if (shortestPath.path.empty()) {
+                QString output = "No path found.";
+                if (QueryStats::ENABLED) output += "\n" + QString::fromStdString(shortestPath.stats.summary());
+                ui->path->setText(output);
+                return;
             }
-        }
-        ostringstream summary;
-        summary << "| " << shortestPath.distanceOrTime << " Km";
-        pathResult.push_back(summary.str());
-        showPath(shortestPath.path, 'd');
-    }
-
-    if (ui->time_rad->isChecked()){
-        auto shortestPath = program->currentGraph->DijkstraTime(city1.toStdString(), city2.toStdString());
-        if (shortestPath.path.empty()) {
-            ui->path->setText("No path found.");
-            return;
-        }
 
-        for (size_t i = 0; i < shortestPath.path.size(); ++i) {
-            pathResult.push_back(shortestPath.path[i]);
-            if (i + 1 < shortestPath.path.size()) {
-                pathResult.push_back("-->");
+            vector<string> pathResult;
+            for (size_t i = 0; i < shortestPath.path.size(); ++i) {
+                pathResult.push_back(shortestPath.path[i]);
+                if (i + 1 < shortestPath.path.size()) {
+                    pathResult.push_back("-->");
+                }
             }
-        }
-        ostringstream summary;
-        summary << "| " << shortestPath.distanceOrTime << " hrs";
-        pathResult.push_back(summary.str());
-        showPath(shortestPath.path, 't');
-    }
+            ostringstream summary;
+            summary << "| " << shortestPath.distanceOrTime << (byTime ? " hrs" : " Km");
+            pathResult.push_back(summary.str());
+            showPath(shortestPath.path, byTime ? 't' : 'd');
+
+            QString output;
+            for (const auto& part : pathResult) {
+                output += QString::fromStdString(part) + " ";
+            }
+            output = output.trimmed();
+            if (recorder.dropped() > 0) {
+                output += QString("\nThe replay skips the first %1 search steps, which did not fit.")
+                              .arg(recorder.dropped());
+            }
+            if (QueryStats::ENABLED) output += "\n" + QString::fromStdString(shortestPath.stats.summary());
+            ui->path->setText(output);
+        });
+}
 
-    QString output;
-    for (const auto& part : pathResult) {
-        output += QString::fromStdString(part) + " ";
+void ExploreMap::showMap(char mode) {
+    TRACE_SPAN("ExploreMap::showMap");
+    if (!program || !program->currentGraph) return;
+
+    const Graph& graph = *program->currentGraph;
+    mapScene->sync(graph, mode == 't');
+
+    // Same positions as the main map: its cached layout is used as is when it
+    // is for this version, and otherwise seeds a layout on the pool, so a big
+    // map never lays out on the GUI thread.
+    shared_ptr<Graph> shown = program->currentGraph;
+    auto cached = atomic_load(&shown->layout);
+    int generation = ++layoutGeneration;
+    if (cached && cached->graphVersion == graph.version) {
+        layoutWorker.cancel();
+        mapScene->setPositions(cached->x, cached->y);
+        return;
     }
-    ui->path->setText(output.trimmed());
+    shared_ptr<const Graph> snapshot = Program::snapshot(shown);
+    if (!snapshot || snapshot->version != shown->version) snapshot = shown->snapshot();
+    LayoutOptions options;
+    options.width = ui->visualizePath->width();
+    options.height = ui->visualizePath->height();
+    layoutWorker.start(snapshot, options, LAYOUT_FRAME_EVERY,
+        [this, generation, shown](shared_ptr<const LayoutWorker::Frame> frame) {
+            QMetaObject::invokeMethod(this, [this, generation, shown, frame]() {
+                if (generation != layoutGeneration) return;
+                mapScene->setPositions(frame->x, frame->y);
+                if (frame->finished) program->storeLayout(shown, frame->result);
+            }, Qt::QueuedConnection);
+        },
+        cached);
 }
 
 void ExploreMap::showPath(const vector<string>& path, char mode) {
@@ -102,205 +178,51 @@ void ExploreMap::showPath(const vector<string>& path, char mode) {
         qWarning() << "Invalid input for path visualization";
         return;
     }
-
-    // Create scene
-    QGraphicsScene* scene = new QGraphicsScene(this);
-    scene->setBackgroundBrush(Qt::black);
-    ui->visualizePath->setScene(scene);
-
-    // Get all cities from the graph
-    vector<string> allCities;
-    for (const auto& [city, _] : program->currentGraph->adj) {
-        allCities.push_back(city);
-    }
-
-    // Initialize node positions in a circle
-    map<string, QPointF> positions;
-    map<string, QPointF> velocities;
-    const double radius = min(ui->visualizePath->width(), ui->visualizePath->height()) * 0.35;
-    const double centerX = ui->visualizePath->width() / 2.0;
-    const double centerY = ui->visualizePath->height() / 2.0;
-
-    for (size_t i = 0; i < allCities.size(); i++) {
-        const double angle = 2.0 * M_PI * i / allCities.size();
-        positions[allCities[i]] = QPointF(
-            centerX + radius * cos(angle),
-            centerY + radius * sin(angle)
-            );
-        velocities[allCities[i]] = QPointF(0, 0);
-    }
-
-    // Calculate average edge value based on mode
-    const auto& graph = program->currentGraph->adj;
-    double totalValue = 0.0;
-    int edgeCount = 0;
-
-    for (const auto& [city, neighbors] : graph) {
-        for (const auto& [neighbor, edgeData] : neighbors) {
-            totalValue += (mode == 't') ? edgeData.second : edgeData.first;
-            edgeCount++;
-        }
-    }
-
-    const double avgValue = (edgeCount > 0) ? totalValue / edgeCount : 100.0;
-    const double valueScale = 200.0 / avgValue;
-
-    // Force-directed layout parameters
-    const int ITERATIONS = 150;
-    const double REPULSION = 10000.0;
-    const double SPRING_K = 0.002;
-    const double DAMPING = 0.85;
-    const double PADDING = 50.0;
-
-    // Run force-directed layout
-    for (int iter = 0; iter < ITERATIONS; iter++) {
-        map<string, QPointF> forces;
-
-        // Initialize forces to zero
-        for (const auto& city : allCities) {
-            forces[city] = QPointF(0, 0);
-        }
-
-        // Calculate repulsive forces
-        for (const auto& city1 : allCities) {
-            for (const auto& city2 : allCities) {
-                if (city1 != city2) {
-                    QPointF delta = positions[city1] - positions[city2];
-                    double distance = max(1.0, hypot(delta.x(), delta.y()));
-                    double repulsion = min(REPULSION / (distance * distance), 200.0);
-                    forces[city1] += delta * (repulsion / distance);
-                }
-            }
-        }
-
-        // Calculate attractive forces (springs)
-        for (const auto& [city, neighbors] : graph) {
-            for (const auto& [neighbor, edgeData] : neighbors) {
-                QPointF delta = positions[city] - positions[neighbor];
-                double distance = max(1.0, hypot(delta.x(), delta.y()));
-                double edgeValue = (mode == 't') ? edgeData.second : edgeData.first;
-                double idealDist = edgeValue * valueScale;
-                double spring = -SPRING_K * (distance - idealDist);
-                forces[city] += delta * (spring / distance);
-            }
-        }
-
-        // Update positions with damping
-        const double maxSpeed = (iter < ITERATIONS / 2) ? 10.0 : 5.0;
-        for (const auto& city : allCities) {
-            velocities[city] = (velocities[city] + forces[city]) * DAMPING;
-
-            // Limit maximum speed
-            double speed = hypot(velocities[city].x(), velocities[city].y());
-            if (speed > maxSpeed) {
-                velocities[city] *= (maxSpeed / speed);
-            }
-
-            // Update position with bounds checking
-            positions[city] += velocities[city];
-            positions[city].setX(clamp(positions[city].x(), PADDING, ui->visualizePath->width() - PADDING));
-            positions[city].setY(clamp(positions[city].y(), PADDING, ui->visualizePath->height() - PADDING));
-        }
-
-        // Additional damping in late iterations
-        if (iter > ITERATIONS * 0.7) {
-            for (auto& [_, vel] : velocities) {
-                vel *= 0.95;
-            }
-        }
+    showMap(mode);
+    mapScene->resetColors();
+
+    // Replay how the search got there first, unless the speed is 0.
+    replayTimer->stop();
+    replayPath = path;
+    if (ui->replaySpeed->value() > 0 && recorder.size() > 0) {
+        replayNext = 0;
+        replayGraph = program->currentGraph;
+        replayVersion = replayGraph->version;
+        replayTimer->start(REPLAY_TICK_MS);
+        return;
     }
+    highlightPath(path);
+}
 
-    // Scale and center the layout
-    double minX = numeric_limits<double>::max();
-    double minY = minX;
-    double maxX = numeric_limits<double>::lowest();
-    double maxY = maxX;
-
-    for (const auto& [_, pos] : positions) {
-        minX = min(minX, pos.x());
-        minY = min(minY, pos.y());
-        maxX = max(maxX, pos.x());
-        maxY = max(maxY, pos.y());
+void ExploreMap::replayStep() {
+    if (replayGraph->version != replayVersion) {
+        replayTimer->stop();
+        return;
     }
 
-    const double scaleX = (maxX > minX) ? (ui->visualizePath->width() - 100) / (maxX - minX) : 1.0;
-    const double scaleY = (maxY > minY) ? (ui->visualizePath->height() - 100) / (maxY - minY) : 1.0;
-    const double scale = min(scaleX, scaleY);
-
-    if (scale < 0.9 || scale > 1.1) {
-        const double centerX = (minX + maxX) / 2;
-        const double centerY = (minY + maxY) / 2;
-        const double viewCenterX = ui->visualizePath->width() / 2;
-        const double viewCenterY = ui->visualizePath->height() / 2;
-
-        for (auto& [_, pos] : positions) {
-            pos = QPointF(
-                (pos.x() - centerX) * scale + viewCenterX,
-                (pos.y() - centerY) * scale + viewCenterY
-                );
-        }
+    // Only the cities and edges of this tick's events are repainted.
+    const auto& names = replayGraph->cityNames;
+    const int speed = ui->replaySpeed->value();
+    const size_t end = speed > 0 ? min(recorder.size(), replayNext + speed) : recorder.size();
+    for (; replayNext < end; replayNext++) {
+        const SearchRecorder::Event& e = recorder[replayNext];
+        const QColor color = e.settled ? QColor(Qt::darkGreen) : QColor(255, 165, 0);
+        const QString city = QString::fromStdString(names[e.city]);
+        mapScene->highlightCity(city, color);
+        if (e.from >= 0) mapScene->highlightEdge(QString::fromStdString(names[e.from]), city, color);
     }
-
-    // Draw all nodes
-    for (const auto& city : allCities) {
-        const QPointF pos = positions.at(city);
-        CityNode* node = new CityNode(QRectF(pos.x()-15, pos.y()-15, 30, 30),
-                                      QString::fromStdString(city));
-
-        // Highlight nodes in path
-        if (std::find(path.begin(), path.end(), city) != path.end()) {
-            node->setBrush(Qt::yellow);
-        }
-
-        scene->addItem(node);
-
-        // Add city label
-        QGraphicsTextItem* label = scene->addText(QString::fromStdString(city));
-        label->setPos(pos.x() - label->boundingRect().width() / 2,
-                      pos.y() + 20);
+    if (replayNext == recorder.size()) {
+        replayTimer->stop();
+        highlightPath(replayPath);
     }
+}
 
-    // Draw all edges
-    set<pair<string, string>> drawnEdges;
-
-    for (const auto& [city, neighbors] : graph) {
-        for (const auto& [neighbor, edgeData] : neighbors) {
-            // Skip if already drawn
-            if (drawnEdges.count({neighbor, city})) continue;
-
-            const QPointF from = positions.at(city);
-            const QPointF to = positions.at(neighbor);
-
-            // Create edge
-            EdgeLine* edge = new EdgeLine(QLineF(from.x(), from.y(), to.x(), to.y()),
-                                          QString::fromStdString(city),
-                                          QString::fromStdString(neighbor));
-
-            // Check if edge is part of the path
-            for (size_t i = 0; i + 1 < path.size(); ++i) {
-                if ((path[i] == city && path[i+1] == neighbor) ||
-                    (path[i] == neighbor && path[i+1] == city)) {
-                    edge->setPen(QPen(Qt::yellow, 3));
-                    break;
-                }
-            }
-
-            scene->addItem(edge);
-
-            // Add edge label (distance or time)
-            const double value = (mode == 't') ? edgeData.second : edgeData.first;
-            const QString unit = (mode == 't') ? " hrs" : " km";
-            QGraphicsTextItem* label = scene->addText(QString::number(value) + unit);
-
-            // Position label perpendicular to edge
-            const QPointF mid = (from + to) / 2;
-            QLineF edgeLine(from, to);
-            QLineF normal = edgeLine.normalVector();
-            normal.setLength(15);
-            label->setPos(mid + QPointF(normal.dx(), normal.dy()));
-            label->setDefaultTextColor(Qt::white);
-
-            drawnEdges.insert({city, neighbor});
+void ExploreMap::highlightPath(const vector<string>& path) {
+    for (size_t i = 0; i < path.size(); ++i) {
+        const QString city = QString::fromStdString(path[i]);
+        mapScene->highlightCity(city, Qt::yellow);
+        if (i + 1 < path.size()) {
+            mapScene->highlightEdge(city, QString::fromStdString(path[i + 1]), Qt::yellow);
         }
     }
 }
@@ -308,5 +230,7 @@ void ExploreMap::showPath(const vector<string>& path, char mode) {
 
 ExploreMap::~ExploreMap()
 {
+    // No layout frame may be queued to a half destroyed dialog.
+    layoutWorker.stop();
     delete ui;
 }
@@ -1,131 +1,143 @@
 #include "filehandler.hpp"
-#include <QFile>
-#include<QTextStream>
-#include<QMessageBox>
+#include "tracer.hpp"
+#include <charconv>
+#include <string_view>
 #include <vector>
 Filehandler::Filehandler() {}
 
-void Filehandler::setGraphs(const vector<Graph>& g) {
-    this->graphs = g;
+namespace {
+bool parseNumber(string_view text, double& value) {
+    auto [ptr, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && ptr == text.data() + text.size();
 }
-void Filehandler::ReadGraphFromFile(const string& filename)
+
+// Shortest text that parses back to the same double, so a saved and
+// reloaded graph has the same contentHash (and keeps its index sidecar).
+void writeNumber(ostream& out, double value) {
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof buffer, value);
+    out.write(buffer, result.ptr - buffer);
+}
+}
+
+bool Filehandler::ReadGraphFromFile(const string& filename, vector<shared_ptr<Graph>>& graphs)
 {
-    QFile file(QString::fromStdString(filename));
-    if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox::critical(nullptr, "Error", "Failed to open file: " + file.errorString());
-        return;
+    TRACE_SPAN("Filehandler::ReadGraphFromFile");
+    lastError.clear();
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        lastError = "Failed to open file: " + filename;
+        return false;
     }
-    QTextStream in(&file);
     graphs.clear();
 
-    bool conversionOk = false;
-    numberOfGraphs = in.readLine().toInt(&conversionOk);
-    if (!conversionOk) {
-        QMessageBox::critical(nullptr, "Error", "Invalid file format: Expected number of graphs");
-        file.close();
-        return;
+    auto readLine = [&file](string& line) {
+        if (!getline(file, line)) return false;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    };
+
+    string line;
+    readLine(line);
+    double count = 0;
+    if (!parseNumber(line, count)) {
+        lastError = "Invalid file format: Expected number of graphs";
+        return false;
     }
+    numberOfGraphs = (int)count;
+
+    string_view parts[4];
+    while (readLine(line)) {
+        string name = line;
+        if (name.empty()) continue;
+
+        // Build straight into the shared store, no temporary copy.
+        auto graph = make_shared<Graph>();
+        Graph& g = *graph;
+        g.name = name;
+
+        while (readLine(line)) {
+            if (line == "#") break;
+
+            string_view rest = line;
+            int found = 0;
+            for (; found < 4 && !rest.empty(); found++) {
+                size_t space = rest.find(' ');
+                parts[found] = rest.substr(0, space);
+                rest = space == string_view::npos ? string_view() : rest.substr(space + 1);
+            }
+            if (found < 4) {
+                lastError = "Error parsing file: Invalid edge format. Expected: source destination distance time";
+                return false;
+            }
 
-    try {
-        while (!in.atEnd()) {
-            string name = in.readLine().toStdString();
-            if (name.empty()) continue;
-
-            Graph g;
-            g.name = name;
-
-            while (!in.atEnd()) {
-                QString line = in.readLine();
-
-                if (line == "#") break;
-
-                QStringList parts = line.split(" ");
-                if (parts.size() < 4) {
-                    throw runtime_error("Invalid edge format. Expected: source destination distance time");
-                }
-
-                QString src = parts[0];
-                QString dest = parts[1];
-
-                g.addCity(src.toStdString());
-
-
-                if (dest == "ISOLATED") {
-
-                    continue;
-                }
-
-                g.addCity(dest.toStdString());
+            string src(parts[0]);
+            g.addCity(src);
 
-                bool distanceOk = false, timeOk = false;
-                double distance = parts[2].toDouble(&distanceOk);
-                double time = parts[3].toDouble(&timeOk);
+            if (parts[1] == "ISOLATED") {
 
-                if (!distanceOk || !timeOk) {
-                    throw runtime_error("Invalid numeric values for distance or time");
-                }
+                continue;
+            }
 
-                g.addEdge(src.toStdString(), dest.toStdString(), distance, time);
+            double distance = 0, time = 0;
+            if (!parseNumber(parts[2], distance) || !parseNumber(parts[3], time)) {
+                lastError = "Error parsing file: Invalid numeric values for distance or time";
+                return false;
             }
-            graphs.push_back(g);
+
+            g.addEdge(src, string(parts[1]), distance, time);
         }
-    } catch (const exception& e) {
-        QMessageBox::critical(nullptr, "Error", "Error parsing file: " + QString::fromStdString(e.what()));
+        graphs.push_back(std::move(graph));
     }
-    file.close();
+    return true;
 }
-void Filehandler::SaveInFile(const string& filename)
+bool Filehandler::SaveInFile(const string& filename, const vector<shared_ptr<Graph>>& graphs)
 {
-    qDebug() << "Number of graphs to save:" << graphs.size();
-    QFile file(QString::fromStdString(filename));
-    if (!file.open(QIODevice::WriteOnly)) {
-        QMessageBox::critical(nullptr, "Error", "Failed to open file for writing: " + file.errorString());
-        return;
+    TRACE_SPAN("Filehandler::SaveInFile");
+    lastError.clear();
+    ofstream out(filename, ios::binary);
+    if (!out.is_open()) {
+        lastError = "Failed to open file for writing: " + filename;
+        return false;
     }
-    QTextStream out(&file);
-
-    out << graphs.size() << Qt::endl;
 
-    for (const Graph& g : graphs) {
+    out << graphs.size() << '\n';
 
-        out << QString::fromStdString(g.name) << Qt::endl;
+    for (const auto& graph : graphs) {
+        const Graph& g = *graph;
 
+        out << g.name << '\n';
 
-        unordered_set<string> processedCities;
+        for (int source = 0; source < g.idCount(); source++) {
+            if (!g.isCity(source)) continue;
 
-        for (const auto& srcPair : g.adj) {
-            const string& source = srcPair.first;
-
-            for (const auto& destPair : srcPair.second) {
-                const string& destination = destPair.first;
-                double distance = destPair.second.first;
-                double time = destPair.second.second;
-
-                if (source < destination) {
-                    out << QString::fromStdString(source) << " "
-                        << QString::fromStdString(destination) << " "
-                        << distance << " "
-                        << time << Qt::endl;
+            // Each undirected edge is written once, from its lower id end.
+            for (const Graph::Edge& e : g.adj[source]) {
+                if (source < e.to) {
+                    out << g.cityNames[source] << " "
+                        << g.cityNames[e.to] << " ";
+                    writeNumber(out, e.distance);
+                    out << " ";
+                    writeNumber(out, e.time);
+                    out << '\n';
                 }
-
-
-                processedCities.insert(source);
-                processedCities.insert(destination);
             }
         }
 
-        for (const auto& srcPair : g.adj) {
-            const string& city = srcPair.first;
+        for (int city = 0; city < g.idCount(); city++) {
+            if (g.isCity(city) && g.adj[city].empty()) {
 
-
-            if (srcPair.second.empty()) {
-
-                out << QString::fromStdString(city) << " ISOLATED 0 0" << Qt::endl;
+                out << g.cityNames[city] << " ISOLATED 0 0" << '\n';
             }
         }
 
 
-        out << "#" << Qt::endl;
+        out << "#" << '\n';
+    }
+    out.close();
+    if (out.fail()) {
+        lastError = "Failed to write file: " + filename;
+        return false;
     }
-    file.close();
+    return true;
 }
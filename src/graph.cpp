@@ -1,89 +1,463 @@
 #include "graph.hpp"
+#include "searchrecorder.hpp"
+#include "tracer.hpp"
 
-void Graph::addCity(const string& name) {
-    if (!containsCity(name)) {
-        adj[name] = {};
-        numberOfCities++;
-    }
+int Graph::cityId(string_view name) const {
+    const int* id = cityIds.find(name);
+    return id ? *id : -1;
+}
+
+shared_ptr<const Graph> Graph::snapshot() const {
+    auto copy = make_shared<Graph>();
+    copy->cachedHash = cachedHash;
+    copy->cityIds = cityIds;
+    copy->numberOfCities = numberOfCities;
+    copy->name = name;
+    copy->cityNames = cityNames;
+    copy->adj = adj;
+    copy->version = version;
+    copy->components = atomic_load(&components);
+    copy->layout = atomic_load(&layout);
+    return copy;
+}
+
+void Graph::reserveCities(int count) {
+    cityNames.reserve(count);
+    adj.reserve(count);
+    cityIds.reserve(count);
+}
+
+int Graph::addCityId(string_view name) {
+    // Looked up first so an existing city costs no string.
+    if (const int* existing = cityIds.find(name)) return *existing;
+    int id = idCount();
+    cityIds.set(name, id);
+    cityNames.emplace_back(name);
+    adj.emplace_back();
+    numberOfCities++;
+    record(Change::CityAdded, id);
+    changed();
+    return id;
+}
+
+void Graph::addCity(string_view name) {
+    if (name.empty()) return; // an empty name marks a deleted id
+    addCityId(name);
 }
 
-int Graph::getnumberOfCities()
+int Graph::getnumberOfCities() const
 {
     return numberOfCities;
 }
 
-vector<string> Graph::getAllCities()
+vector<string> Graph::getAllCities() const
 {
     vector<string>res;
-    for(auto &[city,_]:adj)
+    res.reserve(numberOfCities);
+    for (int id = 0; id < idCount(); id++)
     {
-        res.push_back(city);
+        if (isCity(id)) res.push_back(cityNames[id]);
     }
     return res;
 }
 
-void Graph::addEdge(const string& src, const string& dest, double distance, double time) {
+const Graph::Edge* Graph::findEdge(int src, int dest) const {
+    for (const Edge& e : adj[src]) {
+        if (e.to == dest) return &e;
+    }
+    return nullptr;
+}
+
+void Graph::addEdgeById(int src, int dest, double distance, double time) {
     if (src == dest) return;
     if (distance < 0) distance *= -1;
     if (time < 0) time *= -1;
+    if (const Edge* old = findEdge(src, dest)) {
+        record(Change::EdgeChanged, src, dest, distance, time, old->distance, old->time);
+    } else {
+        record(Change::EdgeAdded, src, dest, distance, time);
+    }
+    changed();
+    setEdge(src, dest, distance, time);
+}
 
+void Graph::setEdge(int src, int dest, double distance, double time) {
     // If the edge already exists, it will be updated.
-    adj[src][dest] = {distance, time};
-    adj[dest][src] = {distance, time};
+    bool updated = false;
+    for (Edge& e : adj[src]) {
+        if (e.to == dest) { e.distance = distance; e.time = time; updated = true; }
+    }
+    for (Edge& e : adj[dest]) {
+        if (e.to == src) { e.distance = distance; e.time = time; }
+    }
+    if (updated) return;
+    adj[src].push_back({dest, distance, time});
+    adj[dest].push_back({src, distance, time});
+}
+
+void Graph::removeEdge(int u, int v) {
+    auto dropEdge = [](vector<Edge>& edges, int to) {
+        edges.erase(remove_if(edges.begin(), edges.end(),
+                              [to](const Edge& e) { return e.to == to; }),
+                    edges.end());
+    };
+    dropEdge(adj[u], v);
+    dropEdge(adj[v], u);
+}
+
+void Graph::addEdge(string_view src, string_view dest, double distance, double time) {
+    if (src == dest || src.empty() || dest.empty()) return;
+    addEdgeById(addCityId(src), addCityId(dest), distance, time);
 }
 
-void Graph::deleteCity(const string& name) {
-    if (!containsCity(name)) return;
-    for (auto& [city, neighbors] : adj) {
-        neighbors.erase(name);
+void Graph::deleteCity(string_view name) {
+    // name may view cityNames[id], so it is not used once that is cleared.
+    int id = cityId(name);
+    if (id < 0) return;
+    // Logged edges first, so undo restores the city before its edges.
+    for (const Edge& e : adj[id]) record(Change::EdgeRemoved, id, e.to, e.distance, e.time);
+    record(Change::CityRemoved, id);
+    // Edges are symmetric, so only the city's own neighbours point back to it.
+    for (const Edge& e : adj[id]) {
+        auto& back = adj[e.to];
+        back.erase(remove_if(back.begin(), back.end(),
+                             [id](const Edge& b) { return b.to == id; }),
+                   back.end());
     }
-    adj.erase(name);
+    adj[id].clear();
+    adj[id].shrink_to_fit();
+    cityIds.erase(cityNames[id]);
+    cityNames[id].clear();
     numberOfCities--;
+    changed();
+}
+
+int Graph::deleteCities(const vector<string>& names) {
+    vector<char> gone(idCount(), 0);
+    vector<int> ids;
+    for (const string& n : names) {
+        int id = cityId(n);
+        if (id < 0 || gone[id]) continue;
+        gone[id] = 1;
+        ids.push_back(id);
+    }
+    if (ids.empty()) return 0;
+
+    // Outside a transaction compact() clears the history instead.
+    if (history.depth > 0) {
+        // An edge between two deleted cities is logged once.
+        for (int id : ids) {
+            for (const Edge& e : adj[id]) {
+                if (!gone[e.to] || e.to > id) record(Change::EdgeRemoved, id, e.to, e.distance, e.time);
+            }
+        }
+        for (int id : ids) record(Change::CityRemoved, id);
+    }
+
+    // Each surviving neighbour is filtered once, however many of its
+    // neighbours go.
+    vector<char> touched(idCount(), 0);
+    for (int id : ids) {
+        for (const Edge& e : adj[id]) {
+            if (gone[e.to] || touched[e.to]) continue;
+            touched[e.to] = 1;
+            auto& back = adj[e.to];
+            back.erase(remove_if(back.begin(), back.end(),
+                                 [&gone](const Edge& b) { return gone[b.to]; }),
+                       back.end());
+        }
+    }
+    for (int id : ids) {
+        adj[id].clear();
+        adj[id].shrink_to_fit();
+        cityIds.erase(cityNames[id]);
+        cityNames[id].clear();
+    }
+    numberOfCities -= (int)ids.size();
+    changed();
+    if (history.depth == 0) compact();
+    return (int)ids.size();
+}
+
+vector<int> Graph::compact() {
+    if (history.depth > 0 || numberOfCities == idCount()) return {};
+    vector<int> newId(idCount(), -1);
+    int next = 0;
+    for (int id = 0; id < idCount(); id++) {
+        if (isCity(id)) newId[id] = next++;
+    }
+    for (int id = 0; id < idCount(); id++) {
+        int to = newId[id];
+        if (to < 0) continue;
+        for (Edge& e : adj[id]) e.to = newId[e.to];
+        if (to != id) {
+            cityNames[to] = std::move(cityNames[id]);
+            adj[to] = std::move(adj[id]);
+        }
+    }
+    cityNames.resize(next);
+    adj.resize(next);
+    cityNames.shrink_to_fit();
+    adj.shrink_to_fit();
+    cityIds.update([&newId](int& id) { id = newId[id]; });
+    clearHistory();
+
+    // Renumbering does not change the content, so caches that were current
+    // stay current. Older ones keep their version and are only remapped.
+    const uint64_t before = version++;
+    if (auto old = atomic_load(&components)) {
+        auto index = make_shared<ComponentIndex>();
+        index->graphVersion = old->graphVersion == before ? version : old->graphVersion;
+        index->count = old->count;
+        index->label.assign(next, -1);
+        for (size_t id = 0; id < old->label.size() && id < newId.size(); id++) {
+            if (newId[id] >= 0) index->label[newId[id]] = old->label[id];
+        }
+        atomic_store(&components, shared_ptr<const ComponentIndex>(index));
+    }
+    if (auto old = atomic_load(&layout)) {
+        auto positions = make_shared<LayoutPositions>();
+        positions->graphVersion = old->graphVersion == before ? version : old->graphVersion;
+        positions->width = old->width;
+        positions->height = old->height;
+        positions->x.assign(next, numeric_limits<float>::quiet_NaN());
+        positions->y.assign(next, numeric_limits<float>::quiet_NaN());
+        for (size_t id = 0; id < min(old->x.size(), old->y.size()) && id < newId.size(); id++) {
+            if (newId[id] >= 0) {
+                positions->x[newId[id]] = old->x[id];
+                positions->y[newId[id]] = old->y[id];
+            }
+        }
+        // Signatures hash neighbour ids, so none survive renumbering; the
+        // next layout computes them again.
+        atomic_store(&layout, shared_ptr<const LayoutPositions>(positions));
+    }
+    return newId;
+}
+
+void Graph::deleteEdge(string_view src, string_view dest) {
+    int u = cityId(src), v = cityId(dest);
+    if (u < 0 || v < 0) return;
+    if (const Edge* e = findEdge(u, v)) record(Change::EdgeRemoved, u, v, e->distance, e->time);
+    removeEdge(u, v);
+    changed();
+}
+
+void Graph::record(Change::Kind kind, int u, int v, double distance, double time,
+                   double oldDistance, double oldTime) {
+    if (history.depth == 0) {
+        // Not undoable, and older entries would no longer apply.
+        if (!history.changes.empty()) clearHistory();
+        history.epoch = newEpoch();
+        return;
+    }
+    if (!history.recorded) {
+        // A new transaction replaces whatever had been undone, names included.
+        if (history.ends.size() > history.applied) history.kept = min(history.kept, history.applied);
+        for (size_t i = history.openStart; i < history.changes.size(); i++) {
+            const Change& c = history.changes[i];
+            if (c.kind == Change::CityAdded || c.kind == Change::CityRemoved) {
+                history.names.resize(c.name);
+                break;
+            }
+        }
+        history.changes.resize(history.openStart);
+        history.ends.resize(history.applied);
+        history.recorded = true;
+    }
+    uint32_t name = 0;
+    if (kind == Change::CityAdded || kind == Change::CityRemoved) {
+        name = (uint32_t)history.names.size();
+        history.names.push_back(cityNames[u]);
+    }
+    history.changes.push_back({kind, name, u, v, distance, time, oldDistance, oldTime});
+}
+
+void Graph::changed() {
+    if (history.depth == 0) {
+        version++;
+    } else if (!history.dirty) {
+        version++;
+        history.dirty = true;
+    }
 }
 
-void Graph::deleteEdge(const string& src, const string& dest) {
-    if (!containsEdge(src, dest)) return;
-    adj[src].erase(dest);
-    adj[dest].erase(src);
+void Graph::apply(const Change& c, bool forward) {
+    switch (c.kind) {
+    case Change::CityAdded:
+    case Change::CityRemoved:
+        if (forward == (c.kind == Change::CityAdded)) {
+            // Back into the id it had; its edges are separate changes.
+            const string& name = history.names[c.name];
+            cityNames[c.u] = name;
+            cityIds.set(name, c.u);
+            numberOfCities++;
+        } else {
+            cityIds.erase(cityNames[c.u]);
+            cityNames[c.u].clear();
+            adj[c.u].clear();
+            numberOfCities--;
+        }
+        break;
+    case Change::EdgeAdded:
+        if (forward) setEdge(c.u, c.v, c.distance, c.time);
+        else removeEdge(c.u, c.v);
+        break;
+    case Change::EdgeChanged:
+        if (forward) setEdge(c.u, c.v, c.distance, c.time);
+        else setEdge(c.u, c.v, c.oldDistance, c.oldTime);
+        break;
+    case Change::EdgeRemoved:
+        if (forward) removeEdge(c.u, c.v);
+        else setEdge(c.u, c.v, c.distance, c.time);
+        break;
+    }
 }
 
-bool Graph::containsCity(const string& name){
-    return(adj.find(name) != adj.end());
+void Graph::beginTransaction() {
+    if (history.depth++ > 0) {
+        // Until the first change the redo tail is still in changes.
+        history.nested.push_back(history.recorded ? history.changes.size() : history.openStart);
+        return;
+    }
+    history.openStart = history.applied ? history.ends[history.applied - 1] : 0;
+    history.recorded = false;
+    history.dirty = false;
 }
 
-bool Graph::containsEdge(const string& city1, const string& city2) {
-    if (containsCity(city1) && adj[city1].find(city2) != adj[city1].end()) {
-        return true;
+bool Graph::commitTransaction() {
+    if (history.depth == 0) return false;
+    if (--history.depth > 0) {
+        history.nested.pop_back();
+        return false;
     }
+    if (history.dirty) version++; // anything cached while it was open is stale
+    // Nested rollbacks may have taken back everything.
+    if (!history.recorded || history.changes.size() == history.openStart) return false;
+    history.ends.push_back(history.changes.size());
+    history.applied = history.ends.size();
+    return true;
+}
 
-    if (containsCity(city2) && adj[city2].find(city1) != adj[city2].end()) {
-        return true;
+void Graph::rollbackTransaction() {
+    if (history.depth == 0) return;
+    if (--history.depth > 0) {
+        // Only this level's changes; the enclosing transactions stay open.
+        size_t start = min(history.nested.back(), history.changes.size());
+        history.nested.pop_back();
+        if (history.recorded && start < history.changes.size()) {
+            revertChanges(start);
+            version++;
+        }
+        return;
     }
+    if (history.recorded) revertChanges(history.openStart);
+    if (history.dirty) version++;
+}
 
-    return false;
+void Graph::revertChanges(size_t start) {
+    for (size_t i = history.changes.size(); i-- > start;) apply(history.changes[i], false);
+    for (size_t i = start; i < history.changes.size(); i++) {
+        const Change& c = history.changes[i];
+        if (c.kind == Change::CityAdded || c.kind == Change::CityRemoved) {
+            history.names.resize(c.name);
+            break;
+        }
+    }
+    history.changes.resize(start);
 }
 
+bool Graph::undo() {
+    if (!canUndo()) return false;
+    size_t end = history.ends[history.applied - 1];
+    size_t begin = history.applied > 1 ? history.ends[history.applied - 2] : 0;
+    for (size_t i = end; i-- > begin;) apply(history.changes[i], false);
+    history.applied--;
+    version++;
+    return true;
+}
+
+bool Graph::redo() {
+    if (!canRedo()) return false;
+    size_t begin = history.applied ? history.ends[history.applied - 1] : 0;
+    size_t end = history.ends[history.applied];
+    for (size_t i = begin; i < end; i++) apply(history.changes[i], true);
+    history.applied++;
+    version++;
+    return true;
+}
+
+void Graph::clearHistory() {
+    history.changes.clear();
+    history.names.clear();
+    history.ends.clear();
+    history.applied = 0;
+    history.openStart = 0;
+    history.recorded = false;
+    history.epoch = newEpoch();
+    history.kept = SIZE_MAX;
+}
+
+uint64_t Graph::newEpoch() {
+    static atomic<uint64_t> last{0};
+    return ++last;
+}
 
-vector<string> Graph::BFS(const string& start) {
+Graph::LogPosition Graph::logPosition() const {
+    if (history.depth > 0) return {};
+    return {history.epoch, history.applied};
+}
+
+bool Graph::changedSince(const LogPosition& p, size_t limit, vector<int>& cities,
+                         vector<pair<int, int>>& edges) const {
+    if (history.depth > 0 || p.epoch != history.epoch || p.applied > min(history.kept, history.ends.size()))
+        return false;
+    // Undone and redone transactions touch the same ids either way.
+    size_t lo = min(p.applied, history.applied), hi = max(p.applied, history.applied);
+    size_t begin = lo ? history.ends[lo - 1] : 0;
+    size_t end = hi ? history.ends[hi - 1] : 0;
+    if (end - begin > limit) return false;
+    for (size_t i = begin; i < end; i++) {
+        const Change& c = history.changes[i];
+        if (c.kind == Change::CityAdded || c.kind == Change::CityRemoved) cities.push_back(c.u);
+        else edges.emplace_back(min(c.u, c.v), max(c.u, c.v));
+    }
+    return true;
+}
+
+bool Graph::containsCity(string_view name) const {
+    return cityIds.find(name) != nullptr;
+}
+
+bool Graph::containsEdge(string_view city1, string_view city2) const {
+    int u = cityId(city1), v = cityId(city2);
+    if (u < 0 || v < 0) return false;
+    return findEdge(u, v) != nullptr || findEdge(v, u) != nullptr;
+}
+
+
+vector<string> Graph::BFS(string_view start) const {
+    TRACE_SPAN("Graph::BFS");
     vector<string> result;
 
-    if (!containsCity(start)) return result;
+    int startId = cityId(start);
+    if (startId < 0) return result;
 
-    unordered_set<string> visited;
-    queue<string> q;
+    vector<char> visited(idCount(), 0);
+    queue<int> q;
 
-    q.push(start);
-    visited.insert(start);
+    q.push(startId);
+    visited[startId] = 1;
 
     while (!q.empty()) {
-        string city = q.front();
+        int city = q.front();
         q.pop();
-        result.push_back(city);
+        result.push_back(cityNames[city]);
 
-        for (const auto& [neighbor, _ ] : adj[city]) { //structured bindings inside range-based for loop
-            if (visited.find(neighbor) == visited.end()) { //couldn't find
-                visited.insert(neighbor);
-                q.push(neighbor);
+        for (const Edge& e : adj[city]) {
+            if (!visited[e.to]) {
+                visited[e.to] = 1;
+                q.push(e.to);
             }
         }
     }
@@ -91,27 +465,29 @@ vector<string> Graph::BFS(const string& start) {
     return result;
 }
 
-vector<string> Graph::DFS(const string& start) {
+vector<string> Graph::DFS(string_view start) const {
+    TRACE_SPAN("Graph::DFS");
     vector<string> result;
 
-    if (!containsCity(start)) return result;
+    int startId = cityId(start);
+    if (startId < 0) return result;
 
-    unordered_set<string> visited;
-    stack<string> st;
+    vector<char> visited(idCount(), 0);
+    stack<int> st;
 
-    st.push(start);
+    st.push(startId);
 
     while (!st.empty()) {
-        string city = st.top();
+        int city = st.top();
         st.pop();
 
-        if (visited.find(city) == visited.end()) {
-            visited.insert(city);
-            result.push_back(city);
+        if (!visited[city]) {
+            visited[city] = 1;
+            result.push_back(cityNames[city]);
 
-            for (const auto& [neighbor, _] : adj[city]) {
-                if (visited.find(neighbor) == visited.end()) {
-                    st.push(neighbor);
+            for (const Edge& e : adj[city]) {
+                if (!visited[e.to]) {
+                    st.push(e.to);
                 }
             }
 
@@ -121,112 +497,285 @@ vector<string> Graph::DFS(const string& start) {
     return result;
 }
 
-Graph::PathResult Graph::DijkstraDistance(const string& start, const string& destination) {
-    PathResult newResult;
+// The generators below hold no references into adj across a co_yield and give up as
+// soon as the graph was edited while they were suspended.
+Generator<Graph::TraversalEvent> Graph::BFSSteps(int start) const {
+    if (!isCity(start)) co_return;
+    const uint64_t startVersion = version;
+
+    vector<int> hops(idCount(), -1), parent(idCount(), -1);
+    queue<int> q;
+    q.push(start);
+    hops[start] = 0;
+
+    while (!q.empty()) {
+        int city = q.front();
+        q.pop();
+        co_yield {TraversalEvent::Visit, city, parent[city], (double)hops[city]};
+        if (version != startVersion) co_return;
+
+        for (size_t i = 0; i < adj[city].size(); i++) {
+            int to = adj[city][i].to;
+            if (hops[to] >= 0) continue;
+            hops[to] = hops[city] + 1;
+            parent[to] = city;
+            q.push(to);
+            co_yield {TraversalEvent::Relax, to, city, (double)hops[to]};
+            if (version != startVersion) co_return;
+        }
+    }
+}
+
+Generator<Graph::TraversalEvent> Graph::DFSSteps(int start) const {
+    if (!isCity(start)) co_return;
+    const uint64_t startVersion = version;
 
-    if (!containsCity(start) || !containsCity(destination)) {
-        return newResult;
+    struct Entry { int city, from, hops; };
+    vector<char> visited(idCount(), 0);
+    stack<Entry> st;
+    st.push({start, -1, 0});
+
+    while (!st.empty()) {
+        Entry top = st.top();
+        st.pop();
+        if (visited[top.city]) continue;
+        visited[top.city] = 1;
+        co_yield {TraversalEvent::Visit, top.city, top.from, (double)top.hops};
+        if (version != startVersion) co_return;
+
+        for (size_t i = 0; i < adj[top.city].size(); i++) {
+            int to = adj[top.city][i].to;
+            if (visited[to]) continue;
+            st.push({to, top.city, top.hops + 1});
+            co_yield {TraversalEvent::Relax, to, top.city, (double)(top.hops + 1)};
+            if (version != startVersion) co_return;
+        }
     }
+}
+
+Generator<Graph::TraversalEvent> Graph::DijkstraSteps(int start, bool byTime, int destination) const {
+    if (!isCity(start)) co_return;
+    const uint64_t startVersion = version;
 
-    unordered_map<string, double> minDistance;
-    unordered_map<string, string> previous;
-    priority_queue<pair<double, string>,
-                        vector<pair<double, string>>,
+    const double INF = numeric_limits<double>::infinity();
+    vector<double> best(idCount(), INF);
+    vector<int> previous(idCount(), -1);
+    priority_queue<pair<double, int>,
+                        vector<pair<double, int>>,
                         greater<>> pq;
 
-    for (const auto& cityPair : adj) {
-        minDistance[cityPair.first] = numeric_limits<double>::infinity();
+    best[start] = 0.0;
+    pq.push({0.0, start});
+
+    while (!pq.empty()) {
+        auto [soFar, city] = pq.top();
+        pq.pop();
+        if (soFar > best[city]) continue;
+
+        co_yield {TraversalEvent::Visit, city, previous[city], soFar};
+        if (version != startVersion || city == destination) co_return;
+
+        for (size_t i = 0; i < adj[city].size(); i++) {
+            int to = adj[city][i].to;
+            double next = soFar + (byTime ? adj[city][i].time : adj[city][i].distance);
+            if (next >= best[to]) continue;
+            best[to] = next;
+            previous[to] = city;
+            pq.push({next, to});
+            co_yield {TraversalEvent::Relax, to, city, next};
+            if (version != startVersion) co_return;
+        }
+    }
+}
+
+template <typename Visitor>
+void Graph::shortestPath(int start, int destination, bool byTime, vector<int>& path, double& cost,
+                         Visitor& visitor, QueryStats& stats) const {
+    // Cities in different components can never be connected.
+    auto index = atomic_load(&components);
+    if (index && index->graphVersion == version && index->label[start] != index->label[destination]) {
+        stats.algorithm = "components";
+        return;
     }
+    stats.algorithm = "dijkstra";
 
-    minDistance[start] = 0.0;
+    const double INF = numeric_limits<double>::infinity();
+    vector<double> best(idCount(), INF);
+    vector<int> previous(idCount(), -1);
+    priority_queue<pair<double, int>,
+                        vector<pair<double, int>>,
+                        greater<>> pq;
+
+    best[start] = 0.0;
     pq.push({0.0, start});
+    stats.push(pq.size());
 
     while (!pq.empty()) {
-        auto [distSoFar, city] = pq.top();
+        auto [soFar, city] = pq.top();
         pq.pop();
+        stats.pop();
 
-        if (distSoFar > minDistance[city]) continue;
+        if (soFar > best[city]) continue;
+        visitor.settle(city, previous[city], soFar);
+        stats.settle();
         if (city == destination) break;
 
-        for (const auto& [neighbor, data] : adj[city]) {
-            double edgeDist = data.first;
-            double newDist = distSoFar + edgeDist;
-
-            if (newDist < minDistance[neighbor]) {
-                minDistance[neighbor] = newDist;
-                previous[neighbor] = city;
-                pq.push({newDist, neighbor});
+        for (const Edge& e : adj[city]) {
+            double next = soFar + (byTime ? e.time : e.distance);
+            if (next < best[e.to]) {
+                best[e.to] = next;
+                previous[e.to] = city;
+                pq.push({next, e.to});
+                stats.push(pq.size());
+                stats.relax();
+                visitor.relax(e.to, city, next);
             }
         }
     }
 
-    if (minDistance[destination] == numeric_limits<double>::infinity()) {
-        return newResult;
-    }
+    if (best[destination] == INF) return;
 
     // Reconstruct path
-    for (string cur = destination; ; cur = previous[cur]) {
-        newResult.path.push_back(cur);
+    for (int cur = destination; cur != -1; cur = previous[cur]) {
+        path.push_back(cur);
         if (cur == start) break;
     }
-    reverse(newResult.path.begin(), newResult.path.end());
-    newResult.distanceOrTime = minDistance[destination];
+    reverse(path.begin(), path.end());
+    cost = best[destination];
+}
 
+template <typename Visitor>
+Graph::PathResult Graph::Dijkstra(string_view start, string_view destination, bool byTime,
+                                  Visitor& visitor) const {
+    TRACE_SPAN("Graph::Dijkstra");
+    PathResult newResult;
+    const auto started = newResult.stats.start();
+
+    int s = cityId(start), t = cityId(destination);
+    if (s < 0 || t < 0) {
+        newResult.stats.algorithm = "unknown city";
+    } else {
+        vector<int> path;
+        shortestPath(s, t, byTime, path, newResult.distanceOrTime, visitor, newResult.stats);
+        for (int id : path) newResult.path.push_back(cityNames[id]);
+    }
+    newResult.stats.stop(started);
     return newResult;
 }
 
+template Graph::PathResult Graph::Dijkstra(string_view, string_view, bool, NoVisitor&) const;
+template Graph::PathResult Graph::Dijkstra(string_view, string_view, bool, SearchRecorder&) const;
 
-Graph::PathResult Graph::DijkstraTime(const string& start, const string& destination) {
-    PathResult newResult;
-
-    if (!containsCity(start) || !containsCity(destination)) {
-        return newResult;
-    }
+Graph::PathResult Graph::DijkstraDistance(string_view start, string_view destination) const {
+    NoVisitor none;
+    return Dijkstra(start, destination, false, none);
+}
 
+Graph::PathResult Graph::DijkstraTime(string_view start, string_view destination) const {
+    NoVisitor none;
+    return Dijkstra(start, destination, true, none);
+}
 
-    unordered_map<string, double> minTime;
-    unordered_map<string, string> previous;
-    priority_queue<pair<double, string>,
-                        vector<pair<double, string>>,
+vector<double> Graph::DijkstraFrom(int start, bool byTime, double limit) const {
+    TRACE_SPAN("Graph::DijkstraFrom");
+    const double INF = numeric_limits<double>::infinity();
+    vector<double> best(idCount(), INF);
+    if (!isCity(start)) return best;
+    priority_queue<pair<double, int>,
+                        vector<pair<double, int>>,
                         greater<>> pq;
 
-
-    for (auto& cityPair : adj) {
-        minTime[cityPair.first] = numeric_limits<double>::infinity();
-    }
-    minTime[start] = 0.0;
+    best[start] = 0.0;
     pq.push({0.0, start});
-
-
     while (!pq.empty()) {
-        auto [timeSoFar, city] = pq.top();
+        auto [soFar, city] = pq.top();
         pq.pop();
-        if (timeSoFar > minTime[city]) continue;
-        if (city == destination) break;
+        if (soFar > best[city]) continue;
 
-        for (auto& [neighbor, data] : adj[city]) {
-            double edgeTime = data.second;
-            double newTime = timeSoFar + edgeTime;
-            if (newTime < minTime[neighbor]) {
-                minTime[neighbor] = newTime;
-                previous[neighbor] = city;
-                pq.push({newTime, neighbor});
+        for (const Edge& e : adj[city]) {
+            double next = soFar + (byTime ? e.time : e.distance);
+            if (next <= limit && next < best[e.to]) {
+                best[e.to] = next;
+                pq.push({next, e.to});
             }
         }
     }
+    return best;
+}
 
+namespace {
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
 
-    if (minTime[destination] == numeric_limits<double>::infinity()) {
-        return newResult;
-    }
+uint64_t hashBytes(const void* data, size_t size) {
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) { h ^= p[i]; h *= 0x100000001b3ULL; }
+    return h;
+}
+}
 
+uint64_t Graph::contentHash() const {
+    if (cachedHash.version.load(memory_order_acquire) == version) return cachedHash.hash.load(memory_order_relaxed);
+
+    // Per city and per edge hashes are summed, so the order cities were
+    // created in (and therefore their ids) does not matter.
+    vector<uint64_t> nameHash(idCount(), 0);
+    uint64_t h = mix64(numberOfCities);
+    for (int id = 0; id < idCount(); id++) {
+        if (!isCity(id)) continue;
+        nameHash[id] = mix64(hashBytes(cityNames[id].data(), cityNames[id].size()));
+        h += nameHash[id];
+    }
+    for (int u = 0; u < idCount(); u++) {
+        for (const Edge& e : adj[u]) {
+            if (u > e.to) continue;
+            uint64_t a = nameHash[u], b = nameHash[e.to];
+            uint64_t edge = mix64(min(a, b) ^ mix64(max(a, b) + hashBytes(&e.distance, sizeof e.distance)));
+            h += mix64(edge ^ hashBytes(&e.time, sizeof e.time));
+        }
+    }
+    cachedHash.version.store(UINT64_MAX, memory_order_relaxed);
+    cachedHash.hash.store(h, memory_order_relaxed);
+    cachedHash.version.store(version, memory_order_release);
+    return h;
+}
 
-    for (string cur = destination; ; cur = previous[cur]) {
-        newResult.path.push_back(cur);
-        if (cur == start) break;
+void Graph::flatAdjacency(vector<int>& offsets, vector<int>& targets) const {
+    offsets.assign(1, 0);
+    offsets.reserve(idCount() + 1);
+    targets.clear();
+    for (const auto& edges : adj) {
+        for (const Edge& e : edges) targets.push_back(e.to);
+        offsets.push_back((int)targets.size());
     }
-    reverse(newResult.path.begin(), newResult.path.end());
-    newResult.distanceOrTime = minTime[destination];
+}
 
-    return newResult;
+shared_ptr<Graph::ComponentIndex> Graph::BuildComponentIndex(const vector<int>& offsets, const vector<int>& targets) {
+    auto index = make_shared<ComponentIndex>();
+    int n = (int)offsets.size() - 1;
+    index->label.assign(n, -1);
+    vector<int> queue;
+    queue.reserve(n);
+    for (int s = 0; s < n; s++) {
+        if (index->label[s] != -1) continue;
+        int label = index->count++;
+        index->label[s] = label;
+        queue.assign(1, s);
+        for (size_t head = 0; head < queue.size(); head++) {
+            int u = queue[head];
+            for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+                int v = targets[i];
+                if (index->label[v] == -1) {
+                    index->label[v] = label;
+                    queue.push_back(v);
+                }
+            }
+        }
+    }
+    return index;
 }
@@ -0,0 +1,409 @@
+#include "graphimporter.hpp"
+#include "tracer.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+namespace {
+
+// Reads a file in 1 MB chunks and hands out lines as views into the chunk.
+// A view is only valid until the next call to nextLine.
+class ChunkedLineReader
+{
+public:
+    explicit ChunkedLineReader(const string& path)
+        : file(fopen(path.c_str(), "rb")), buffer(1 << 20) {}
+    ~ChunkedLineReader() { if (file) fclose(file); }
+    ChunkedLineReader(const ChunkedLineReader&) = delete;
+    ChunkedLineReader& operator=(const ChunkedLineReader&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    bool nextLine(string_view& line) {
+        for (;;) {
+            const char* data = buffer.data();
+            const char* nl = static_cast<const char*>(memchr(data + begin, '\n', end - begin));
+            if (nl) {
+                line = trimCR(string_view(data + begin, nl - (data + begin)));
+                begin = nl - data + 1;
+                return true;
+            }
+            if (eof) {
+                if (begin == end) return false;
+                line = trimCR(string_view(data + begin, end - begin));
+                begin = end;
+                return true;
+            }
+            // Keep the partial line and refill behind it, growing only for
+            // lines longer than the whole buffer.
+            size_t rest = end - begin;
+            memmove(buffer.data(), data + begin, rest);
+            begin = 0;
+            end = rest;
+            if (end == buffer.size()) buffer.resize(buffer.size() * 2);
+            size_t got = fread(buffer.data() + end, 1, buffer.size() - end, file);
+            if (got == 0) eof = true;
+            end += got;
+        }
+    }
+
+private:
+    static string_view trimCR(string_view s) {
+        if (!s.empty() && s.back() == '\r') s.remove_suffix(1);
+        return s;
+    }
+
+    FILE* file;
+    vector<char> buffer;
+    size_t begin = 0, end = 0;
+    bool eof = false;
+};
+
+bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+string_view trimBlanks(string_view s) {
+    while (!s.empty() && isBlank(s.front())) s.remove_prefix(1);
+    while (!s.empty() && isBlank(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+// Trims blanks and one pair of surrounding quotes.
+string_view trim(string_view s) {
+    s = trimBlanks(s);
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') s = s.substr(1, s.size() - 2);
+    return s;
+}
+
+// Whitespace separated token parsing for the DIMACS formats.
+template <typename T>
+bool parseNext(const char*& p, const char* e, T& value) {
+    while (p < e && isBlank(*p)) ++p;
+    auto [ptr, ec] = from_chars(p, e, value);
+    if (ec != errc()) return false;
+    if constexpr (is_floating_point_v<T>) {
+        if (!isfinite(value)) return false; // from_chars takes nan and inf
+    }
+    p = ptr;
+    return true;
+}
+
+bool parseField(string_view field, double& value) {
+    field = trim(field);
+    auto [ptr, ec] = from_chars(field.data(), field.data() + field.size(), value);
+    return ec == errc() && ptr == field.data() + field.size() && isfinite(value);
+}
+
+// The map file separates fields with single spaces, so a city name with a
+// space in it would not load again once saved.
+bool savableName(string_view name) {
+    return name.find(' ') == string_view::npos;
+}
+
+string spaceError(long long line, string_view name) {
+    return "City names cannot contain spaces, on line " + to_string(line) + ": " + string(name);
+}
+
+// Splits at most maxFields fields; returns how many were found.
+int splitFields(string_view line, char delimiter, string_view* fields, int maxFields) {
+    int count = 0;
+    while (count < maxFields) {
+        if (delimiter == ' ') line = trimBlanks(line); // runs of spaces separate once
+        size_t pos = line.find(delimiter);
+        fields[count++] = trim(line.substr(0, pos));
+        if (pos == string_view::npos) break;
+        line.remove_prefix(pos + 1);
+    }
+    return count;
+}
+
+char detectDelimiter(string_view line) {
+    for (char c : {',', '\t', ';'}) {
+        if (line.find(c) != string_view::npos) return c;
+    }
+    return ' ';
+}
+
+// wasalney_mapgen writes integer DIMACS files and notes the scale in a
+// comment, "c wasalney_mapgen distances in metres (km x 1000)". Returns that
+// factor, or 0 for any other line.
+double mapgenScale(string_view line) {
+    const string_view tag = "c wasalney_mapgen ";
+    size_t x = line.rfind(" x ");
+    if (line.substr(0, tag.size()) != tag || x == string_view::npos) return 0;
+    double scale = 0;
+    auto [ptr, ec] = from_chars(line.data() + x + 3, line.data() + line.size(), scale);
+    return ec == errc() && ptr < line.data() + line.size() && *ptr == ')' && isfinite(scale) && scale > 0
+        ? scale : 0;
+}
+
+// One edge list line: source, destination, distance[, time]. False when the
+// line is not an edge, e.g. a header.
+bool parseEdge(string_view line, char delimiter, string_view& from, string_view& to,
+               double& distance, double& time) {
+    string_view fields[4];
+    int count = splitFields(line, delimiter, fields, 4);
+    bool numeric = count >= 3 && parseField(fields[2], distance);
+    if (numeric && count == 4) {
+        numeric = parseField(fields[3], time);
+    } else {
+        time = distance;
+    }
+    from = fields[0];
+    to = fields[1];
+    return numeric && !from.empty() && !to.empty();
+}
+
+// Every unordered pair keeps one weight, that of its arc with the smallest
+// distance in either direction, on both sides; arcs without a reverse get
+// one. The result is the symmetric adjacency Graph relies on.
+void normalizeAdjacency(Graph& g) {
+    TRACE_SPAN("normalizeAdjacency");
+    auto cheaper = [](const Graph::Edge& a, const Graph::Edge& b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.time < b.time);
+    };
+    auto byTarget = [&](const Graph::Edge& a, const Graph::Edge& b) {
+        return a.to < b.to || (a.to == b.to && cheaper(a, b));
+    };
+    for (int id = 0; id < g.idCount(); id++) {
+        auto& edges = g.adj[id];
+        sort(edges.begin(), edges.end(), byTarget);
+        edges.erase(unique(edges.begin(), edges.end(),
+                           [](const Graph::Edge& a, const Graph::Edge& b) { return a.to == b.to; }),
+                    edges.end());
+    }
+
+    auto reverse = [&g](int u, int v) -> Graph::Edge* {
+        auto& back = g.adj[v];
+        auto it = lower_bound(back.begin(), back.end(), u,
+                              [](const Graph::Edge& b, int to) { return b.to < to; });
+        return it == back.end() || it->to != u ? nullptr : &*it;
+    };
+    vector<pair<int, Graph::Edge>> missing;
+    for (int u = 0; u < g.idCount(); u++) {
+        for (Graph::Edge& e : g.adj[u]) {
+            Graph::Edge* back = reverse(u, e.to);
+            if (!back) {
+                missing.push_back({e.to, {u, e.distance, e.time}});
+            } else if (u < e.to) { // each pair once
+                const Graph::Edge& best = cheaper(*back, e) ? *back : e;
+                e.distance = back->distance = best.distance;
+                e.time = back->time = best.time;
+            }
+        }
+    }
+    for (const auto& [v, e] : missing) g.adj[v].push_back(e);
+    g.version++;
+}
+
+} // namespace
+
+bool GraphImporter::ImportDimacs(const string& grPath, Graph& g,
+                                 const string& timeGrPath, const string& coPath)
+{
+    TRACE_SPAN("GraphImporter::ImportDimacs");
+    lastError.clear();
+    linesRead = 0;
+    coordX.clear();
+    coordY.clear();
+
+    if (g.idCount() != 0) {
+        lastError = "DIMACS import needs an empty graph";
+        return false;
+    }
+    ChunkedLineReader gr(grPath);
+    if (!gr.isOpen()) {
+        lastError = "Failed to open file: " + grPath;
+        return false;
+    }
+    unique_ptr<ChunkedLineReader> timeGr;
+    if (!timeGrPath.empty()) {
+        timeGr = make_unique<ChunkedLineReader>(timeGrPath);
+        if (!timeGr->isOpen()) {
+            lastError = "Failed to open file: " + timeGrPath;
+            return false;
+        }
+    }
+
+    long long nodes = -1;
+    double distanceScale = 1, timeScale = 1; // file units per km and per hour
+    string_view line;
+    while (gr.nextLine(line)) {
+        linesRead++;
+        if (!line.empty() && line[0] == 'c' && mapgenScale(line) > 0) distanceScale = mapgenScale(line);
+        if (line.empty() || line[0] == 'c') continue;
+        const char* p = line.data() + 1;
+        const char* e = line.data() + line.size();
+
+        if (line[0] == 'p') {
+            long long arcs = 0;
+            while (p < e && isBlank(*p)) ++p;
+            bool shortestPath = e - p >= 2 && p[0] == 's' && p[1] == 'p';
+            if (shortestPath) p += 2;
+            if (!shortestPath || !parseNext(p, e, nodes) || !parseNext(p, e, arcs)
+                || nodes < 0 || nodes > numeric_limits<int>::max()) {
+                lastError = "Invalid problem line " + to_string(linesRead);
+                return false;
+            }
+            g.reserveCities((int)nodes);
+            char digits[24];
+            for (long long i = 1; i <= nodes; i++) {
+                auto res = to_chars(digits, digits + sizeof(digits), i);
+                g.addCityId(string(digits, res.ptr));
+            }
+            continue;
+        }
+
+        if (line[0] != 'a') continue;
+        long long u = 0, v = 0;
+        double w = 0;
+        if (nodes < 0 || !parseNext(p, e, u) || !parseNext(p, e, v) || !parseNext(p, e, w)
+            || u < 1 || v < 1 || u > nodes || v > nodes) {
+            lastError = "Invalid arc on line " + to_string(linesRead);
+            return false;
+        }
+
+        double t = w;
+        if (timeGr) {
+            string_view timeLine;
+            bool found = false;
+            while (timeGr->nextLine(timeLine)) {
+                if (!timeLine.empty() && timeLine[0] == 'a') { found = true; break; }
+                if (mapgenScale(timeLine) > 0) timeScale = mapgenScale(timeLine);
+            }
+            long long tu = 0, tv = 0;
+            const char* tp = found ? timeLine.data() + 1 : nullptr;
+            const char* te = found ? timeLine.data() + timeLine.size() : nullptr;
+            if (!found || !parseNext(tp, te, tu) || !parseNext(tp, te, tv) || !parseNext(tp, te, t)
+                || tu != u || tv != v) {
+                lastError = "Time file does not match arc on line " + to_string(linesRead);
+                return false;
+            }
+        }
+
+        if (u != v) {
+            // Back to km and hours; without a time file t is a distance.
+            double distance = (w < 0 ? -w : w) / distanceScale;
+            double time = (t < 0 ? -t : t) / (timeGr ? timeScale : distanceScale);
+            g.adj[u - 1].push_back({int(v - 1), distance, time});
+        }
+    }
+    if (nodes < 0) {
+        lastError = "Missing problem line in " + grPath;
+        return false;
+    }
+    normalizeAdjacency(g);
+
+    if (!coPath.empty()) {
+        ChunkedLineReader co(coPath);
+        if (!co.isOpen()) {
+            lastError = "Failed to open file: " + coPath;
+            return false;
+        }
+        coordX.assign(nodes, NAN);
+        coordY.assign(nodes, NAN);
+        while (co.nextLine(line)) {
+            if (line.empty() || line[0] != 'v') continue;
+            const char* p = line.data() + 1;
+            const char* e = line.data() + line.size();
+            long long id = 0;
+            double x = 0, y = 0;
+            if (!parseNext(p, e, id) || !parseNext(p, e, x) || !parseNext(p, e, y) || id < 1 || id > nodes) {
+                lastError = "Invalid coordinate line in " + coPath;
+                return false;
+            }
+            coordX[id - 1] = x;
+            coordY[id - 1] = y;
+        }
+    }
+    return true;
+}
+
+bool GraphImporter::ImportEdgeList(const string& path, Graph& g)
+{
+    lastError.clear();
+    linesRead = 0;
+    coordX.clear();
+    coordY.clear();
+
+    ChunkedLineReader in(path);
+    if (!in.isOpen()) {
+        lastError = "Failed to open file: " + path;
+        return false;
+    }
+
+    char delimiter = 0;
+    string_view line, from, to;
+    while (in.nextLine(line)) {
+        linesRead++;
+        if (trim(line).empty()) continue;
+
+        bool firstLine = delimiter == 0;
+        if (firstLine) delimiter = detectDelimiter(line);
+
+        double distance = 0, time = 0;
+        if (!parseEdge(line, delimiter, from, to, distance, time)) {
+            if (firstLine) continue; // header
+            lastError = "Invalid edge on line " + to_string(linesRead)
+                        + ". Expected: source destination distance [time]";
+            return false;
+        }
+        if (!savableName(from) || !savableName(to)) {
+            lastError = spaceError(linesRead, savableName(from) ? to : from);
+            return false;
+        }
+
+        int u = g.addCityId(from);
+        int v = g.addCityId(to);
+        if (u != v) {
+            g.adj[u].push_back({v, distance < 0 ? -distance : distance, time < 0 ? -time : time});
+        }
+    }
+    normalizeAdjacency(g);
+    return true;
+}
+
+bool GraphImporter::ApplyEdgeList(string_view text, Graph& g)
+{
+    lastError.clear();
+    linesRead = 0;
+
+    g.beginTransaction();
+    bool firstLine = true;
+    string_view from, to;
+    while (!text.empty()) {
+        size_t nl = text.find('\n');
+        string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == string_view::npos ? text.size() : nl + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        linesRead++;
+        if (trim(line).empty()) continue;
+
+        // Pasted lines may come from different sources, so each one gets its
+        // own delimiter.
+        double distance = 0, time = 0;
+        bool edge = parseEdge(line, detectDelimiter(line), from, to, distance, time);
+        bool city = !edge && to.empty() && !from.empty();
+        if ((edge || city) && (!savableName(from) || !savableName(to))) {
+            g.rollbackTransaction();
+            lastError = spaceError(linesRead, savableName(from) ? to : from);
+            return false;
+        }
+        if (edge) {
+            int u = g.addCityId(from);
+            g.addEdgeById(u, g.addCityId(to), distance, time);
+        } else if (city) {
+            g.addCityId(from);
+        } else if (!firstLine) { // else a header
+            g.rollbackTransaction();
+            lastError = "Invalid line " + to_string(linesRead)
+                        + ". Expected: source destination distance [time], or a city name";
+            return false;
+        }
+        firstLine = false;
+    }
+    g.commitTransaction();
+    return true;
+}
@@ -0,0 +1,630 @@
+#include "graphlayout.hpp"
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+namespace {
+const int MaxTreeDepth = 32;
+const int LeafBodies = 8;     // summed directly, cheaper than splitting further
+const int CoarsestCities = 64;
+const int MaxGroupSize = 16;
+const float RefineCutoff = 3.0f; // in ideal edge lengths
+const float RefineTheta = 1.2f;  // coarser is fine once repulsion is local
+
+uint64_t mix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+}
+
+vector<uint64_t> GraphLayout::EdgeSignatures(const Graph& g)
+{
+    vector<uint64_t> signature(g.idCount(), 0);
+    for (int id = 0; id < g.idCount(); id++) {
+        // Order independent, so re-sorted adjacency lists hash the same.
+        for (const Graph::Edge& e : g.adj[id]) {
+            uint64_t distance, time;
+            memcpy(&distance, &e.distance, sizeof distance);
+            memcpy(&time, &e.time, sizeof time);
+            signature[id] += mix(uint64_t(e.to) ^ mix(distance ^ mix(time)));
+        }
+    }
+    return signature;
+}
+
+GraphLayout::GraphLayout(const Graph& g, const LayoutOptions& options)
+    : options(options), graphVersion(g.version), areaWidth(options.width), areaHeight(options.height),
+      kernel(options.kernel ? options.kernel : &LayoutKernel::Best()), signature(EdgeSignatures(g))
+{
+    int n = g.idCount();
+    live.assign(n, 0);
+    x.assign(n, 0.0f);
+    y.assign(n, 0.0f);
+    vx.assign(n, 0.0f);
+    vy.assign(n, 0.0f);
+    fx.assign(n, 0.0f);
+    fy.assign(n, 0.0f);
+    for (int id = 0; id < n; id++) {
+        if (!g.isCity(id)) continue;
+        live[id] = 1;
+        ids.push_back(id);
+    }
+    movers = ids;
+
+    // Start on a circle for a better initial spread.
+    double radius = min(options.width, options.height) * 0.35;
+    for (size_t i = 0; i < ids.size(); i++) {
+        double angle = 2.0 * M_PI * i / ids.size();
+        x[ids[i]] = float(options.width / 2.0 + radius * cos(angle));
+        y[ids[i]] = float(options.height / 2.0 + radius * sin(angle));
+    }
+
+    // Ideal spring lengths scale the average edge to about 200 px.
+    double total = 0.0;
+    edgeOffsets.assign(n + 1, 0);
+    for (int id = 0; id < n; id++) {
+        edgeOffsets[id + 1] = edgeOffsets[id] + (int)g.adj[id].size();
+        for (const Graph::Edge& e : g.adj[id]) total += options.byTime ? e.time : e.distance;
+    }
+    int edgeCount = edgeOffsets[n];
+    double average = edgeCount > 0 && total > 0 ? total / edgeCount : 100.0;
+    double scale = 200.0 / average;
+    edgeTargets.reserve(edgeCount);
+    edgeLength.reserve(edgeCount);
+    for (int id = 0; id < n; id++) {
+        for (const Graph::Edge& e : g.adj[id]) {
+            edgeTargets.push_back(e.to);
+            edgeLength.push_back(float((options.byTime ? e.time : e.distance) * scale));
+        }
+    }
+    prepareEdges();
+}
+
+GraphLayout::GraphLayout(const LayoutOptions& options, vector<int> offsets, vector<int> targets,
+                         vector<float> lengths)
+    : options(options), areaWidth(options.width), areaHeight(options.height),
+      kernel(options.kernel ? options.kernel : &LayoutKernel::Best()), edgeOffsets(std::move(offsets)), edgeTargets(std::move(targets)), edgeLength(std::move(lengths))
+{
+    int n = (int)edgeOffsets.size() - 1;
+    live.assign(n, 1);
+    ids.resize(n);
+    iota(ids.begin(), ids.end(), 0);
+    movers = ids;
+    vx.assign(n, 0.0f);
+    vy.assign(n, 0.0f);
+    fx.assign(n, 0.0f);
+    fy.assign(n, 0.0f);
+    x.resize(n);
+    y.resize(n);
+    double radius = min(options.width, options.height) * 0.35;
+    for (int i = 0; i < n; i++) {
+        double angle = 2.0 * M_PI * i / n;
+        x[i] = float(options.width / 2.0 + radius * cos(angle));
+        y[i] = float(options.height / 2.0 + radius * sin(angle));
+    }
+    prepareEdges();
+}
+
+void GraphLayout::prepareEdges()
+{
+    // The kernels take edges as flat (source, target) pairs.
+    edgeSources.resize(edgeTargets.size());
+    for (int id = 0; id + 1 < (int)edgeOffsets.size(); id++) {
+        fill(edgeSources.begin() + edgeOffsets[id], edgeSources.begin() + edgeOffsets[id + 1], id);
+    }
+    springX.assign(edgeTargets.size(), 0.0f);
+    springY.assign(edgeTargets.size(), 0.0f);
+}
+
+int GraphLayout::build(int first, int count, float midX, float midY, float half, int depth)
+{
+    int index = (int)tree.size();
+    tree.push_back(QuadNode{0, 0, 0, midX, midY, half, {-1, -1, -1, -1}, first, count});
+
+    float sx = 0, sy = 0;
+    for (int i = first; i < first + count; i++) {
+        sx += x[order[i]];
+        sy += y[order[i]];
+    }
+    tree[index].mass = (float)count;
+    tree[index].cx = sx / count;
+    tree[index].cy = sy / count;
+    if (count <= LeafBodies || depth >= MaxTreeDepth) return index;
+
+    // Split into quadrants in place: [left top, right top, left bottom, right bottom].
+    int* begin = order.data() + first;
+    int* end = begin + count;
+    int* midSplit = partition(begin, end, [&](int id) { return y[id] < midY; });
+    int* topSplit = partition(begin, midSplit, [&](int id) { return x[id] < midX; });
+    int* bottomSplit = partition(midSplit, end, [&](int id) { return x[id] < midX; });
+    int* bounds[5] = {begin, topSplit, midSplit, bottomSplit, end};
+
+    float q = half / 2;
+    for (int c = 0; c < 4; c++) {
+        int childCount = int(bounds[c + 1] - bounds[c]);
+        if (childCount == 0) continue;
+        int child = build(int(bounds[c] - order.data()), childCount,
+                          midX + (c & 1 ? q : -q), midY + (c & 2 ? q : -q), q, depth + 1);
+        tree[index].child[c] = child;
+    }
+    return index;
+}
+
+void GraphLayout::applyRepulsion()
+{
+    if (ids.empty()) return;
+    float minX = x[ids[0]], maxX = minX, minY = y[ids[0]], maxY = minY;
+    for (int id : ids) {
+        minX = min(minX, x[id]);
+        maxX = max(maxX, x[id]);
+        minY = min(minY, y[id]);
+        maxY = max(maxY, y[id]);
+    }
+    tree.clear();
+    order = ids;
+    float half = max(maxX - minX, maxY - minY) / 2 + 1.0f;
+    build(0, (int)order.size(), (minX + maxX) / 2, (minY + maxY) / 2, half, 0);
+    orderX.resize(order.size());
+    orderY.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        orderX[i] = x[order[i]];
+        orderY[i] = y[order[i]];
+    }
+
+    const float theta = repulsionCutoff > 0 ? max((float)options.theta, RefineTheta) : (float)options.theta;
+    const float theta2 = theta * theta;
+    const float repulsion = (float)options.repulsion;
+    const float cutoff2 = repulsionCutoff * repulsionCutoff;
+    // Walking bodies in tree order keeps consecutive walks on the same cells.
+    const vector<int>& bodies = movers.size() == ids.size() ? order : movers;
+    vector<int> stack;
+    for (int id : bodies) {
+        float px = x[id], py = y[id];
+        float ax = 0, ay = 0;
+        stack.assign(1, 0);
+        while (!stack.empty()) {
+            const QuadNode& node = tree[stack.back()];
+            stack.pop_back();
+            if (cutoff2 > 0) {
+                float gapX = max(0.0f, fabs(px - node.midX) - node.half);
+                float gapY = max(0.0f, fabs(py - node.midY) - node.half);
+                if (gapX * gapX + gapY * gapY > cutoff2) continue;
+            }
+            bool leaf = node.child[0] < 0 && node.child[1] < 0 && node.child[2] < 0 && node.child[3] < 0;
+            if (leaf) {
+                // The body itself is at distance 0 and adds nothing.
+                kernel->repel(px, py, &orderX[node.first], &orderY[node.first], node.count, repulsion, ax, ay);
+                continue;
+            }
+            // Far enough away: treat the whole cell as one body at its center of mass.
+            float dx = px - node.cx, dy = py - node.cy;
+            float size = 2 * node.half;
+            if (size * size < theta2 * (dx * dx + dy * dy)) {
+                repelOne(dx, dy, node.mass, repulsion, ax, ay);
+                continue;
+            }
+            for (int c : node.child) {
+                if (c >= 0) stack.push_back(c);
+            }
+        }
+        fx[id] += ax;
+        fy[id] += ay;
+    }
+}
+
+void GraphLayout::applySprings()
+{
+    const float springK = (float)options.springK;
+    if (movers.size() == ids.size()) {
+        kernel->springs(edgeSources.data(), edgeTargets.data(), edgeLength.data(), (int)edgeTargets.size(),
+                        x.data(), y.data(), springK, springX.data(), springY.data());
+    } else {
+        for (int id : movers) {
+            int first = edgeOffsets[id];
+            kernel->springs(edgeSources.data() + first, edgeTargets.data() + first, edgeLength.data() + first,
+                            edgeOffsets[id + 1] - first, x.data(), y.data(), springK,
+                            springX.data() + first, springY.data() + first);
+        }
+    }
+    for (int id : movers) {
+        for (int k = edgeOffsets[id]; k < edgeOffsets[id + 1]; k++) {
+            fx[id] += springX[k];
+            fy[id] += springY[k];
+        }
+    }
+}
+
+void GraphLayout::integrate()
+{
+    LayoutKernel::IntegrateParams p;
+    p.centerX = float(areaWidth / 2);
+    p.centerY = float(areaHeight / 2);
+    p.centerRadius = centerRadius;
+    p.damping = (float)options.damping;
+    p.maxSpeed = (iteration < options.iterations / 2 ? 10.0f : 5.0f) * speedScale;
+    p.minX = p.minY = (float)options.padding;
+    p.maxX = max(p.minX, float(areaWidth - options.padding));
+    p.maxY = max(p.minY, float(areaHeight - options.padding));
+    p.settling = iteration > options.iterations * 0.7;
+
+    if (movers.size() == ids.size()) {
+        // Deleted ids have no forces; moving them along does no harm.
+        kernel->integrate(p, x.data(), y.data(), vx.data(), vy.data(), fx.data(), fy.data(), (int)x.size());
+        return;
+    }
+    for (int id : movers) {
+        LayoutKernel::Scalar().integrate(p, &x[id], &y[id], &vx[id], &vy[id], &fx[id], &fy[id], 1);
+    }
+}
+
+bool GraphLayout::seed(const Graph::LayoutPositions& previous)
+{
+    const size_t known = min(previous.x.size(), previous.y.size());
+    const bool exact = previous.graphVersion == graphVersion;
+    if (!exact && previous.edgeSignature.size() < known) return false;
+
+    vector<char> changed(live.size(), 0);
+    size_t changedCount = 0;
+    for (int id : ids) {
+        bool placed = (size_t)id < known && !isnan(previous.x[id]) && !isnan(previous.y[id]);
+        if (!placed || (!exact && previous.edgeSignature[id] != signature[id])) {
+            changed[id] = 1;
+            changedCount++;
+        }
+    }
+    if (changedCount > max<size_t>(20, ids.size() / 5)) return false;
+
+    // Map the cached area onto ours, keeping the aspect ratio.
+    double scale = 1.0, offsetX = 0.0, offsetY = 0.0;
+    if (previous.width > 0 && previous.height > 0) {
+        scale = min(options.width / previous.width, options.height / previous.height);
+        offsetX = (options.width - previous.width * scale) / 2;
+        offsetY = (options.height - previous.height * scale) / 2;
+    }
+    vector<char> isNew(live.size(), 0);
+    for (int id : ids) {
+        if ((size_t)id < known && !isnan(previous.x[id]) && !isnan(previous.y[id])) {
+            x[id] = float(previous.x[id] * scale + offsetX);
+            y[id] = float(previous.y[id] * scale + offsetY);
+        } else {
+            isNew[id] = 1;
+        }
+    }
+
+    // New cities start near their placed neighbours, slightly apart so they
+    // do not sit on top of each other.
+    for (int id : ids) {
+        if (!isNew[id]) continue;
+        float sx = 0, sy = 0;
+        int count = 0;
+        for (int k = edgeOffsets[id]; k < edgeOffsets[id + 1]; k++) {
+            int other = edgeTargets[k];
+            if (isNew[other]) continue;
+            sx += x[other];
+            sy += y[other];
+            count++;
+        }
+        float angle = id * 2.39996f;
+        x[id] = (count ? sx / count : float(options.width / 2)) + 20 * cos(angle);
+        y[id] = (count ? sy / count : float(options.height / 2)) + 20 * sin(angle);
+    }
+
+    // Changed cities and their neighbours relax, everything else is pinned.
+    vector<char> moves(live.size(), 0);
+    for (int id : ids) {
+        if (!changed[id]) continue;
+        moves[id] = 1;
+        for (int k = edgeOffsets[id]; k < edgeOffsets[id + 1]; k++) moves[edgeTargets[k]] = 1;
+    }
+    movers.clear();
+    for (int id : ids) {
+        if (moves[id]) movers.push_back(id);
+        vx[id] = vy[id] = 0;
+    }
+    iteration = 0;
+    seeded = true;
+    options.iterations = movers.empty() ? 0 : min(options.iterations, options.incrementalIterations);
+    return true;
+}
+
+shared_ptr<Graph::LayoutPositions> GraphLayout::snapshot() const
+{
+    auto positions = make_shared<Graph::LayoutPositions>();
+    positions->graphVersion = graphVersion;
+    positions->width = (float)options.width;
+    positions->height = (float)options.height;
+    positions->x.assign(live.size(), NAN);
+    positions->y.assign(live.size(), NAN);
+    for (int id : ids) {
+        positions->x[id] = x[id];
+        positions->y[id] = y[id];
+    }
+    positions->edgeSignature = signature;
+    return positions;
+}
+
+void GraphLayout::step()
+{
+    if (done()) return;
+    if (iteration == 0 && options.multilevel && !seeded && (int)ids.size() >= options.multilevelMinCities) {
+        placeMultilevel();
+        if (done()) return;
+    }
+    applyRepulsion();
+    applySprings();
+    integrate();
+    iteration++;
+}
+
+void GraphLayout::run()
+{
+    while (!done()) step();
+}
+
+void GraphLayout::fitToView()
+{
+    fittedPositions(x, y);
+}
+
+void GraphLayout::fittedPositions(vector<float>& outX, vector<float>& outY) const
+{
+    if (&outX != &x) outX = x;
+    if (&outY != &y) outY = y;
+    if (ids.empty()) return;
+    float minX = x[ids[0]], maxX = minX, minY = y[ids[0]], maxY = minY;
+    for (int id : ids) {
+        minX = min(minX, x[id]);
+        maxX = max(maxX, x[id]);
+        minY = min(minY, y[id]);
+        maxY = max(maxY, y[id]);
+    }
+    double scaleX = maxX > minX ? (options.width - 2 * options.padding) / (maxX - minX) : 1.0;
+    double scaleY = maxY > minY ? (options.height - 2 * options.padding) / (maxY - minY) : 1.0;
+    double scale = min(scaleX, scaleY);
+    if (scale >= 0.9 && scale <= 1.1) return;
+
+    double centerX = (minX + maxX) / 2.0, centerY = (minY + maxY) / 2.0;
+    for (int id : ids) {
+        outX[id] = float((x[id] - centerX) * scale + options.width / 2);
+        outY[id] = float((y[id] - centerY) * scale + options.height / 2);
+    }
+}
+
+void GraphLayout::placeMultilevel()
+{
+    struct Level {
+        vector<int> offsets, targets;
+        vector<float> lengths;
+        vector<int> parent;  // node of the next coarser level
+        float lengthScale;   // edge lengths relative to the finest level
+    };
+
+    // The finest level is this graph on compact indices 0..m-1.
+    const int m = (int)ids.size();
+    vector<int> compact(live.size(), -1);
+    for (int i = 0; i < m; i++) compact[ids[i]] = i;
+    vector<Level> levels(1);
+    levels[0].lengthScale = 1.0f;
+    levels[0].offsets.assign(m + 1, 0);
+    for (int i = 0; i < m; i++) {
+        for (int k = edgeOffsets[ids[i]]; k < edgeOffsets[ids[i] + 1]; k++) {
+            if (compact[edgeTargets[k]] < 0) continue;
+            levels[0].targets.push_back(compact[edgeTargets[k]]);
+            levels[0].lengths.push_back(edgeLength[k]);
+        }
+        levels[0].offsets[i + 1] = (int)levels[0].targets.size();
+    }
+
+    // Coarsen by matching each node with the unmatched neighbour over its
+    // shortest edge; nodes left without one join their nearest neighbour's
+    // group, which also collapses stars.
+    mt19937 random(1);
+    while ((int)levels.back().offsets.size() - 1 > CoarsestCities) {
+        const Level& fine = levels.back();
+        const int n = (int)fine.offsets.size() - 1;
+        vector<int> visit(n);
+        iota(visit.begin(), visit.end(), 0);
+        shuffle(visit.begin(), visit.end(), random);
+        vector<int> group(n, -1), groupSize;
+        for (int u : visit) {
+            if (group[u] >= 0) continue;
+            int free = -1, near = -1;
+            float freeLength = numeric_limits<float>::max(), nearLength = freeLength;
+            for (int k = fine.offsets[u]; k < fine.offsets[u + 1]; k++) {
+                int v = fine.targets[k];
+                if (v == u) continue;
+                if (group[v] < 0 && fine.lengths[k] < freeLength) {
+                    free = v;
+                    freeLength = fine.lengths[k];
+                } else if (group[v] >= 0 && groupSize[group[v]] < MaxGroupSize && fine.lengths[k] < nearLength) {
+                    near = v;
+                    nearLength = fine.lengths[k];
+                }
+            }
+            if (free < 0 && near >= 0) {
+                group[u] = group[near];
+                groupSize[group[u]]++;
+                continue;
+            }
+            group[u] = (int)groupSize.size();
+            groupSize.push_back(1);
+            if (free >= 0) {
+                group[free] = group[u];
+                groupSize[group[u]]++;
+            }
+        }
+        const int groups = (int)groupSize.size();
+        if (groups > n * 0.9) break;
+
+        // Members of each group, then the contracted edges with averaged lengths.
+        vector<int> start(groups + 1, 0), members(n);
+        for (int u = 0; u < n; u++) start[group[u] + 1]++;
+        partial_sum(start.begin(), start.end(), start.begin());
+        vector<int> fill(start.begin(), start.end() - 1);
+        for (int u = 0; u < n; u++) members[fill[group[u]]++] = u;
+
+        const float stepScale = (float)sqrt(double(n) / groups);
+        Level coarse;
+        coarse.lengthScale = fine.lengthScale * stepScale;
+        coarse.offsets.assign(groups + 1, 0);
+        vector<int> mark(groups, -1), slot(groups);
+        vector<float> sum;
+        vector<int> count;
+        for (int c = 0; c < groups; c++) {
+            for (int i = start[c]; i < start[c + 1]; i++) {
+                int u = members[i];
+                for (int k = fine.offsets[u]; k < fine.offsets[u + 1]; k++) {
+                    int t = group[fine.targets[k]];
+                    if (t == c) continue;
+                    if (mark[t] != c) {
+                        mark[t] = c;
+                        slot[t] = (int)coarse.targets.size();
+                        coarse.targets.push_back(t);
+                        sum.push_back(0);
+                        count.push_back(0);
+                    }
+                    sum[slot[t]] += fine.lengths[k];
+                    count[slot[t]]++;
+                }
+            }
+            coarse.offsets[c + 1] = (int)coarse.targets.size();
+        }
+        coarse.lengths.resize(sum.size());
+        for (size_t k = 0; k < sum.size(); k++) coarse.lengths[k] = sum[k] / count[k] * stepScale;
+        levels.back().parent = std::move(group);
+        levels.push_back(std::move(coarse));
+    }
+
+    if (levels.size() == 1) return; // nothing to coarsen, lay out as usual
+
+    // Big graphs get a virtual area with room for their ideal edge lengths;
+    // fitToView scales it back down to the view.
+    double grow = max(1.0, 200.0 * sqrt((double)m) / sqrt(options.width * options.height));
+    LayoutOptions levelOptions = options;
+    levelOptions.multilevel = false;
+    levelOptions.width = options.width * grow;
+    levelOptions.height = options.height * grow;
+
+    vector<float> px, py;
+    for (int l = (int)levels.size() - 1; l >= 0; l--) {
+        Level& level = levels[l];
+        const int n = (int)level.offsets.size() - 1;
+        const float scale = level.lengthScale;
+        levelOptions.repulsion = options.repulsion * scale * scale;
+        levelOptions.iterations = l == (int)levels.size() - 1 ? options.iterations : options.refineIterations;
+
+        // Children start around their parent, spread by this level's edge length.
+        vector<float> lx(n), ly(n);
+        if (l + 1 < (int)levels.size()) {
+            for (int u = 0; u < n; u++) {
+                float angle = u * 2.39996f;
+                float radius = 0.3f * 200.0f * scale;
+                lx[u] = px[level.parent[u]] + radius * cos(angle);
+                ly[u] = py[level.parent[u]] + radius * sin(angle);
+            }
+        }
+
+        if (l == 0) {
+            // The finest level is this layout; step() refines it.
+            for (int i = 0; i < m; i++) {
+                x[ids[i]] = lx[i];
+                y[ids[i]] = ly[i];
+                vx[ids[i]] = vy[ids[i]] = 0;
+            }
+            areaWidth = levelOptions.width;
+            areaHeight = levelOptions.height;
+            centerRadius = float(300.0 * grow);
+            repulsionCutoff = RefineCutoff * 200.0f;
+            options.iterations = min(options.iterations, options.refineIterations);
+            break;
+        }
+
+        GraphLayout layout(levelOptions, std::move(level.offsets), std::move(level.targets), std::move(level.lengths));
+        layout.speedScale = scale;
+        layout.centerRadius = float(300.0 * grow);
+        if (l + 1 < (int)levels.size()) {
+            // The coarser levels fixed the global shape; refining only needs
+            // local repulsion.
+            layout.repulsionCutoff = RefineCutoff * 200.0f * scale;
+            layout.x = std::move(lx);
+            layout.y = std::move(ly);
+        }
+        layout.run();
+        px = std::move(layout.x);
+        py = std::move(layout.y);
+
+        if (onLevel) {
+            // Every city at its group's place on this level.
+            for (int i = 0; i < m; i++) {
+                int group = i;
+                for (int k = 0; k < l; k++) group = levels[k].parent[group];
+                x[ids[i]] = px[group];
+                y[ids[i]] = py[group];
+            }
+            if (!onLevel()) {
+                iteration = options.iterations;
+                return;
+            }
+        }
+    }
+}
+
+namespace {
+// Orientation of c relative to the line a-b.
+float orient(float ax, float ay, float bx, float by, float cx, float cy)
+{
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+}
+
+LayoutQuality GraphLayout::Measure(const Graph& g, const vector<float>& x, const vector<float>& y,
+                                   long long samplePairs)
+{
+    LayoutQuality quality;
+    vector<pair<int, int>> edges;
+    double sum = 0, sumSquares = 0;
+    for (int id = 0; id < g.idCount() && id < (int)x.size(); id++) {
+        for (const Graph::Edge& e : g.adj[id]) {
+            if (e.to <= id || e.to >= (int)x.size() || isnan(x[id]) || isnan(x[e.to])) continue;
+            double length = hypot(x[id] - x[e.to], y[id] - y[e.to]);
+            sum += length;
+            sumSquares += length * length;
+            edges.push_back({id, e.to});
+        }
+    }
+    if (edges.empty()) return quality;
+    double mean = sum / edges.size();
+    if (mean > 0) quality.edgeLengthVariance = (sumSquares / edges.size() - mean * mean) / (mean * mean);
+
+    auto crosses = [&](const pair<int, int>& a, const pair<int, int>& b) {
+        if (a.first == b.first || a.first == b.second || a.second == b.first || a.second == b.second) return false;
+        float d1 = orient(x[a.first], y[a.first], x[a.second], y[a.second], x[b.first], y[b.first]);
+        float d2 = orient(x[a.first], y[a.first], x[a.second], y[a.second], x[b.second], y[b.second]);
+        float d3 = orient(x[b.first], y[b.first], x[b.second], y[b.second], x[a.first], y[a.first]);
+        float d4 = orient(x[b.first], y[b.first], x[b.second], y[b.second], x[a.second], y[a.second]);
+        return ((d1 > 0) != (d2 > 0)) && ((d3 > 0) != (d4 > 0)) && d1 && d2 && d3 && d4;
+    };
+    long long e = (long long)edges.size();
+    if (e * (e - 1) / 2 <= samplePairs) {
+        for (long long i = 0; i < e; i++) {
+            for (long long j = i + 1; j < e; j++) {
+                quality.crossingPairs++;
+                quality.crossings += crosses(edges[i], edges[j]);
+            }
+        }
+        return quality;
+    }
+    mt19937_64 random(1);
+    uniform_int_distribution<long long> pick(0, e - 1);
+    for (long long i = 0; i < samplePairs; i++) {
+        long long a = pick(random), b = pick(random);
+        if (a == b) continue;
+        quality.crossingPairs++;
+        quality.crossings += crosses(edges[a], edges[b]);
+    }
+    return quality;
+}
@@ -0,0 +1,347 @@
+#include "graphviewitems.hpp"
+#include <QFontMetricsF>
+#include <QHash>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QVector>
+#include <cmath>
+#include <limits>
+
+namespace {
+const qreal EDGE_WIDTH = 3;
+const int MAX_CELLS_PER_EDGE = 64; // longer edges are checked on every query
+const qreal LABEL_MARGIN = 60;     // labels reach this far past their edge
+
+uint64_t endsKey(int a, int b)
+{
+    if (a > b) swap(a, b);
+    return (uint64_t(uint32_t(a)) << 32) | uint32_t(b);
+}
+
+qreal distanceToSegment(const QPointF& p, const QLineF& line)
+{
+    QPointF d = line.p2() - line.p1();
+    qreal length2 = d.x() * d.x() + d.y() * d.y();
+    qreal t = length2 > 0 ? QPointF::dotProduct(p - line.p1(), d) / length2 : 0;
+    t = qBound<qreal>(0, t, 1);
+    return QLineF(p, line.p1() + t * d).length();
+}
+}
+
+EdgeBatch::EdgeBatch()
+{
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption); // fills option->exposedRect
+    setZValue(-1);                                        // under the cities
+}
+
+void EdgeBatch::setEdges(vector<Edge> newEdges)
+{
+    // Highlights stay with the edges that are still there.
+    QHash<QPair<QString, QString>, QColor> kept;
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (colors[i].isValid()) kept.insert(qMakePair(edges[i].fromCity, edges[i].toCity), colors[i]);
+    }
+
+    prepareGeometryChange();
+    edges = std::move(newEdges);
+    colors.assign(edges.size(), QColor());
+    byEnds.clear();
+    for (size_t i = 0; i < edges.size(); i++) {
+        byEnds[endsKey(edges[i].from, edges[i].to)] = (int)i;
+        if (kept.isEmpty()) continue;
+        auto it = kept.find(qMakePair(edges[i].fromCity, edges[i].toCity));
+        if (it != kept.end()) colors[i] = *it;
+    }
+    // Nothing is drawn until setPositions() places the new edges.
+    lines.clear();
+    bounds = QRectF();
+    seen.assign(edges.size(), 0);
+    stamp = 0;
+    update();
+}
+
+void EdgeBatch::setEdge(const Edge& edge)
+{
+    auto [it, added] = byEnds.try_emplace(endsKey(edge.from, edge.to), (int)edges.size());
+    if (added) {
+        edges.push_back(edge);
+        colors.emplace_back();
+        seen.push_back(0);
+    } else {
+        edges[it->second] = edge;
+    }
+    clearLines();
+}
+
+void EdgeBatch::removeEdge(int from, int to)
+{
+    auto it = byEnds.find(endsKey(from, to));
+    if (it == byEnds.end()) return;
+    // The last edge takes the freed index.
+    int i = it->second;
+    byEnds.erase(it);
+    int last = (int)edges.size() - 1;
+    if (i != last) {
+        edges[i] = std::move(edges[last]);
+        colors[i] = colors[last];
+        byEnds[endsKey(edges[i].from, edges[i].to)] = i;
+    }
+    edges.pop_back();
+    colors.pop_back();
+    seen.pop_back();
+    clearLines();
+}
+
+void EdgeBatch::clearLines()
+{
+    if (lines.empty()) return;
+    prepareGeometryChange();
+    lines.clear();
+    bounds = QRectF();
+    update();
+}
+
+void EdgeBatch::setPositions(const vector<float>& x, const vector<float>& y)
+{
+    prepareGeometryChange();
+    lines.resize(edges.size());
+    bounds = QRectF();
+    for (size_t i = 0; i < edges.size(); i++) {
+        lines[i] = QLineF(x[edges[i].from], y[edges[i].from], x[edges[i].to], y[edges[i].to]);
+        bounds |= QRectF(lines[i].p1(), lines[i].p2()).normalized().adjusted(-1, -1, 1, 1);
+    }
+
+    // About one edge per cell on average.
+    qreal side = max(bounds.width(), bounds.height());
+    cellSize = max<qreal>(1, side / max(1.0, sqrt((double)edges.size())));
+    columns = max(1, (int)ceil(bounds.width() / cellSize));
+    rows = max(1, (int)ceil(bounds.height() / cellSize));
+    auto cellRange = [&](const QLineF& line, int& c0, int& r0, int& c1, int& r1) {
+        QRectF box = QRectF(line.p1(), line.p2()).normalized();
+        c0 = qBound(0, int((box.left() - bounds.left()) / cellSize), columns - 1);
+        c1 = qBound(0, int((box.right() - bounds.left()) / cellSize), columns - 1);
+        r0 = qBound(0, int((box.top() - bounds.top()) / cellSize), rows - 1);
+        r1 = qBound(0, int((box.bottom() - bounds.top()) / cellSize), rows - 1);
+    };
+
+    // Count, then fill.
+    cellStart.assign(size_t(columns) * rows + 1, 0);
+    longEdges.clear();
+    for (size_t i = 0; i < lines.size(); i++) {
+        int c0, r0, c1, r1;
+        cellRange(lines[i], c0, r0, c1, r1);
+        if ((c1 - c0 + 1) * (r1 - r0 + 1) > MAX_CELLS_PER_EDGE) {
+            longEdges.push_back((int)i);
+            continue;
+        }
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++) cellStart[r * columns + c + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+    cellEdges.resize(cellStart.back());
+    vector<int> next(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < lines.size(); i++) {
+        int c0, r0, c1, r1;
+        cellRange(lines[i], c0, r0, c1, r1);
+        if ((c1 - c0 + 1) * (r1 - r0 + 1) > MAX_CELLS_PER_EDGE) continue;
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++) cellEdges[next[r * columns + c]++] = (int)i;
+    }
+    update();
+}
+
+vector<int> EdgeBatch::query(const QRectF& rect) const
+{
+    vector<int> found;
+    if (lines.empty() || !rect.intersects(bounds)) return found;
+    if (stamp == numeric_limits<int>::max()) {
+        fill(seen.begin(), seen.end(), 0);
+        stamp = 0;
+    }
+    stamp++;
+    auto consider = [&](int i) {
+        if (seen[i] == stamp) return;
+        seen[i] = stamp;
+        if (QRectF(lines[i].p1(), lines[i].p2()).normalized().adjusted(-1, -1, 1, 1).intersects(rect))
+            found.push_back(i);
+    };
+    QRectF area = rect & bounds;
+    int c0 = qBound(0, int((area.left() - bounds.left()) / cellSize), columns - 1);
+    int c1 = qBound(0, int((area.right() - bounds.left()) / cellSize), columns - 1);
+    int r0 = qBound(0, int((area.top() - bounds.top()) / cellSize), rows - 1);
+    int r1 = qBound(0, int((area.bottom() - bounds.top()) / cellSize), rows - 1);
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * columns + c;
+            for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++) consider(cellEdges[k]);
+        }
+    }
+    for (int i : longEdges) consider(i);
+    return found;
+}
+
+int EdgeBatch::find(int from, int to) const
+{
+    auto it = byEnds.find(endsKey(from, to));
+    return it == byEnds.end() ? -1 : it->second;
+}
+
+void EdgeBatch::setColor(int edge, const QColor& color)
+{
+    if (edge < 0 || edge >= (int)colors.size()) return;
+    colors[edge] = color;
+    if (edge < (int)lines.size()) {
+        update(QRectF(lines[edge].p1(), lines[edge].p2()).normalized().adjusted(-EDGE_WIDTH, -EDGE_WIDTH,
+                                                                               EDGE_WIDTH, EDGE_WIDTH));
+    }
+}
+
+QColor EdgeBatch::color(int edge) const
+{
+    return edge >= 0 && edge < (int)colors.size() ? colors[edge] : QColor();
+}
+
+void EdgeBatch::resetColors()
+{
+    colors.assign(edges.size(), QColor());
+    update();
+}
+
+void EdgeBatch::setLabelsVisible(bool visible)
+{
+    if (visible == labelsVisible) return;
+    labelsVisible = visible;
+    update();
+}
+
+int EdgeBatch::edgeAt(const QPointF& pos, qreal tolerance) const
+{
+    int best = -1;
+    qreal bestDistance = tolerance;
+    for (int i : query(QRectF(pos.x() - tolerance, pos.y() - tolerance, 2 * tolerance, 2 * tolerance))) {
+        qreal d = distanceToSegment(pos, lines[i]);
+        if (d <= bestDistance) {
+            best = i;
+            bestDistance = d;
+        }
+    }
+    return best;
+}
+
+QRectF EdgeBatch::boundingRect() const
+{
+    return bounds.adjusted(-LABEL_MARGIN, -LABEL_MARGIN, LABEL_MARGIN, LABEL_MARGIN);
+}
+
+void EdgeBatch::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
+{
+    vector<int> visible = query(option->exposedRect.adjusted(-LABEL_MARGIN, -LABEL_MARGIN, LABEL_MARGIN, LABEL_MARGIN));
+
+    // Plain edges in one call, highlighted ones on top.
+    QVector<QLineF> plain;
+    plain.reserve((int)visible.size());
+    for (int i : visible) {
+        if (!colors[i].isValid()) plain.push_back(lines[i]);
+    }
+    painter->setPen(QPen(Qt::red, EDGE_WIDTH));
+    painter->drawLines(plain);
+    for (int i : visible) {
+        if (!colors[i].isValid()) continue;
+        painter->setPen(QPen(colors[i], EDGE_WIDTH));
+        painter->drawLine(lines[i]);
+    }
+
+    if (!labelsVisible) return;
+    // Labels sit next to the middle of their edge, like the text items did.
+    painter->setPen(Qt::white);
+    const qreal ascent = QFontMetricsF(painter->font()).ascent();
+    for (int i : visible) {
+        QLineF normal = lines[i].normalVector();
+        normal.setLength(15);
+        QPointF pos = lines[i].center() + QPointF(normal.dx(), normal.dy());
+        painter->drawText(pos + QPointF(0, ascent), edges[i].label);
+    }
+}
+
+ClusterLayer::ClusterLayer()
+{
+    setZValue(1);
+}
+
+void ClusterLayer::setPositions(const vector<float>& x, const vector<float>& y, const vector<int>& ids)
+{
+    points.clear();
+    points.reserve(ids.size());
+    for (int id : ids) points.push_back(QPointF(x[id], y[id]));
+    rebuild();
+}
+
+void ClusterLayer::setCellSize(qreal size)
+{
+    if (size == cellSize) return;
+    cellSize = size;
+    rebuild();
+}
+
+void ClusterLayer::rebuild()
+{
+    prepareGeometryChange();
+    clusters.clear();
+    bounds = QRectF();
+    unordered_map<uint64_t, int> byCell;
+    for (const QPointF& p : points) {
+        uint64_t key = (uint64_t(uint32_t(int(floor(p.x() / cellSize)))) << 32) | uint32_t(int(floor(p.y() / cellSize)));
+        auto it = byCell.find(key);
+        if (it == byCell.end()) {
+            byCell[key] = (int)clusters.size();
+            clusters.push_back(Cluster{p, QRectF(p, QSizeF(0.001, 0.001)), 1});
+            continue;
+        }
+        Cluster& cluster = clusters[it->second];
+        cluster.center += p;
+        cluster.area |= QRectF(p, QSizeF(0.001, 0.001));
+        cluster.count++;
+    }
+    for (Cluster& cluster : clusters) {
+        cluster.center /= cluster.count;
+        bounds |= QRectF(cluster.center, QSizeF(0, 0)).adjusted(-cellSize, -cellSize, cellSize, cellSize);
+    }
+    update();
+}
+
+QRectF ClusterLayer::boundingRect() const
+{
+    return bounds;
+}
+
+void ClusterLayer::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
+{
+    // Circles grow slowly with the number of cities; counts are drawn in
+    // screen pixels so they stay readable however far out the view is.
+    const qreal zoom = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    painter->setPen(QPen(Qt::black, 0));
+    painter->setBrush(Qt::cyan);
+    for (const Cluster& cluster : clusters) {
+        qreal radius = cellSize * min(0.45, 0.15 + 0.05 * log2((double)cluster.count));
+        painter->drawEllipse(cluster.center, radius, radius);
+        if (cluster.count == 1) continue;
+        painter->save();
+        painter->translate(cluster.center);
+        painter->scale(1 / zoom, 1 / zoom);
+        qreal r = radius * zoom;
+        painter->drawText(QRectF(-r, -r, 2 * r, 2 * r), Qt::AlignCenter, QString::number(cluster.count));
+        painter->restore();
+    }
+}
+
+void ClusterLayer::mousePressEvent(QGraphicsSceneMouseEvent* event)
+{
+    for (const Cluster& cluster : clusters) {
+        qreal radius = cellSize * 0.45;
+        if (QLineF(event->pos(), cluster.center).length() > radius) continue;
+        if (onClicked) onClicked(cluster.area.adjusted(-cellSize / 2, -cellSize / 2, cellSize / 2, cellSize / 2));
+        event->accept();
+        return;
+    }
+    event->ignore();
+}
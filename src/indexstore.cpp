@@ -0,0 +1,279 @@
+#include "indexstore.hpp"
+#include <cctype>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct IndexStore::Header {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t sectionCount;
+    uint64_t contentHash;
+    uint64_t cityCount;
+    uint64_t namesOffset; // uint64_t offsets[cityCount + 1], then the name bytes
+    uint64_t namesBytes;
+    uint64_t fileSize;
+};
+
+struct IndexStore::SectionEntry {
+    char tag[16];
+    uint64_t offset;
+    uint64_t count;
+    uint32_t elementSize;
+    uint32_t reserved;
+};
+
+namespace {
+const char Magic[8] = {'W', 'S', 'L', 'N', 'I', 'D', 'X', '\0'};
+
+uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+}
+
+IndexStore::IndexStore() {}
+
+IndexStore::~IndexStore()
+{
+    Close();
+}
+
+string IndexStore::SidecarPath(const string& mapFile, const string& graphName)
+{
+    // Other bytes become %XX, so different names never share a file.
+    static const char hex[] = "0123456789ABCDEF";
+    string safe;
+    for (unsigned char c : graphName) {
+        if (isalnum(c) || c == '-' || c == '_') {
+            safe += char(c);
+        } else {
+            safe += '%';
+            safe += hex[c >> 4];
+            safe += hex[c & 15];
+        }
+    }
+    return mapFile + "." + safe + ".idx";
+}
+
+bool IndexStore::Save(const string& path, const vector<string>& cityNames, uint64_t contentHash,
+                      const vector<Section>& sections, string& error)
+{
+    uint64_t cityCount = 0;
+    uint64_t namesBytes = 0;
+    for (const string& name : cityNames) {
+        if (name.empty()) continue;
+        cityCount++;
+        namesBytes += name.size();
+    }
+
+    Header header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.formatVersion = FormatVersion;
+    header.sectionCount = (uint32_t)sections.size();
+    header.contentHash = contentHash;
+    header.cityCount = cityCount;
+    header.namesOffset = sizeof(Header) + sections.size() * sizeof(SectionEntry);
+    header.namesBytes = namesBytes;
+
+    vector<SectionEntry> table(sections.size());
+    uint64_t offset = align8(header.namesOffset + (cityCount + 1) * sizeof(uint64_t) + namesBytes);
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (sections[i].tag.size() >= sizeof(table[i].tag)) {
+            error = "Index section tag too long: " + sections[i].tag;
+            return false;
+        }
+        memcpy(table[i].tag, sections[i].tag.c_str(), sections[i].tag.size() + 1);
+        table[i].offset = offset;
+        table[i].count = sections[i].count;
+        table[i].elementSize = sections[i].elementSize;
+        offset = align8(offset + sections[i].count * sections[i].elementSize);
+    }
+    header.fileSize = offset;
+
+    string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        error = "Failed to open index file for writing: " + tmpPath;
+        return false;
+    }
+    static const char zeros[8] = {};
+    uint64_t written = 0;
+    auto put = [&](const void* data, uint64_t bytes) {
+        if (bytes && fwrite(data, 1, bytes, file) != bytes) return false;
+        written += bytes;
+        return true;
+    };
+    auto pad = [&]() { return put(zeros, align8(written) - written); };
+
+    bool ok = put(&header, sizeof(header)) && put(table.data(), table.size() * sizeof(SectionEntry));
+    uint64_t nameOffset = 0;
+    for (size_t id = 0; ok && id < cityNames.size(); id++) {
+        if (cityNames[id].empty()) continue;
+        ok = put(&nameOffset, sizeof(nameOffset));
+        nameOffset += cityNames[id].size();
+    }
+    ok = ok && put(&nameOffset, sizeof(nameOffset));
+    for (size_t id = 0; ok && id < cityNames.size(); id++) {
+        ok = put(cityNames[id].data(), cityNames[id].size());
+    }
+    ok = ok && pad();
+    for (size_t i = 0; ok && i < sections.size(); i++) {
+        ok = put(sections[i].data, sections[i].count * sections[i].elementSize) && pad();
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(tmpPath.c_str());
+        error = "Failed to write index file: " + tmpPath;
+        return false;
+    }
+
+    remove(path.c_str());
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        error = "Failed to replace index file: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool IndexStore::Open(const string& path, const Graph& g)
+{
+    Close();
+    lastError.clear();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        lastError = "No index file";
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE map = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (LONGLONG)sizeof(Header)) {
+        map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (!map) {
+        lastError = "Index file too small or cannot be mapped";
+        return false;
+    }
+    void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(map);
+        lastError = "Index file cannot be mapped";
+        return false;
+    }
+    mapping = map;
+    base = static_cast<const char*>(view);
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        lastError = "No index file";
+        return false;
+    }
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+        view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        lastError = "Index file too small or cannot be mapped";
+        return false;
+    }
+    base = static_cast<const char*>(view);
+    size = st.st_size;
+#endif
+
+    auto fail = [&](const string& reason) {
+        Close();
+        lastError = reason;
+        return false;
+    };
+
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0) return fail("Not an index file");
+    if (header.formatVersion != FormatVersion) return fail("Index format version changed");
+    if (header.fileSize != size) return fail("Index file truncated");
+
+    uint64_t tableEnd = sizeof(Header) + uint64_t(header.sectionCount) * sizeof(SectionEntry);
+    if (header.sectionCount > 4096 || tableEnd > size || header.namesOffset != tableEnd
+        || header.cityCount > size / sizeof(uint64_t) || header.namesBytes > size
+        || header.namesOffset + (header.cityCount + 1) * sizeof(uint64_t) + header.namesBytes > size) {
+        return fail("Index file corrupt");
+    }
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        SectionEntry entry;
+        memcpy(&entry, base + sizeof(Header) + i * sizeof(SectionEntry), sizeof(entry));
+        if (entry.offset % 8 != 0 || entry.offset > size || entry.elementSize == 0
+            || entry.count > (size - entry.offset) / entry.elementSize
+            || memchr(entry.tag, '\0', sizeof(entry.tag)) == nullptr) {
+            return fail("Index file corrupt");
+        }
+    }
+
+    if (header.contentHash != g.contentHash() || header.cityCount != (uint64_t)g.numberOfCities) {
+        return fail("Graph changed since the index was built");
+    }
+
+    // Match stored cities to current ids; identical order allows zero copy views.
+    const uint64_t* nameOffsets = reinterpret_cast<const uint64_t*>(base + header.namesOffset);
+    const char* names = reinterpret_cast<const char*>(nameOffsets + header.cityCount + 1);
+    idCount = g.idCount();
+    storedToId.assign(header.cityCount, -1);
+    idsMatch = header.cityCount == (uint64_t)g.idCount();
+    for (uint64_t i = 0; i < header.cityCount; i++) {
+        uint64_t begin = nameOffsets[i], end = nameOffsets[i + 1];
+        if (begin > end || end > header.namesBytes) return fail("Index file corrupt");
+        string_view stored(names + begin, end - begin);
+        if (idsMatch && stored == g.cityNames[i]) {
+            storedToId[i] = (int)i;
+            continue;
+        }
+        idsMatch = false;
+        storedToId[i] = g.cityId(stored);
+    }
+    return true;
+}
+
+void IndexStore::Close()
+{
+    if (base) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(static_cast<HANDLE>(mapping));
+#else
+        munmap(const_cast<char*>(base), size);
+#endif
+    }
+    base = nullptr;
+    mapping = nullptr;
+    size = 0;
+    idsMatch = false;
+    storedToId.clear();
+}
+
+const void* IndexStore::view(const string& tag, uint32_t elementSize, uint64_t& count) const
+{
+    count = 0;
+    if (!base) return nullptr;
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        SectionEntry entry;
+        memcpy(&entry, base + sizeof(Header) + i * sizeof(SectionEntry), sizeof(entry));
+        if (tag == entry.tag && entry.elementSize == elementSize) {
+            count = entry.count;
+            return base + entry.offset;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,315 @@
+#include "layoutkernel.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LAYOUT_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile each SIMD version for its own instruction set, so the
+// rest of the build keeps the default target; MSVC needs no annotation.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace {
+void repelScalar(float px, float py, const float* xs, const float* ys, int count,
+                 float repulsion, float& ax, float& ay)
+{
+    float sx = 0, sy = 0;
+    for (int i = 0; i < count; i++) repelOne(px - xs[i], py - ys[i], 1.0f, repulsion, sx, sy);
+    ax += sx;
+    ay += sy;
+}
+
+inline void springOne(int k, const int* sources, const int* targets, const float* lengths,
+                      const float* x, const float* y, float springK, float* outX, float* outY)
+{
+    float dx = x[sources[k]] - x[targets[k]], dy = y[sources[k]] - y[targets[k]];
+    float d = max(1.0f, sqrt(dx * dx + dy * dy));
+    float spring = -springK * (d - lengths[k]);
+    outX[k] = dx * (spring / d);
+    outY[k] = dy * (spring / d);
+}
+
+void springsScalar(const int* sources, const int* targets, const float* lengths, int count,
+                   const float* x, const float* y, float springK, float* outX, float* outY)
+{
+    for (int k = 0; k < count; k++) springOne(k, sources, targets, lengths, x, y, springK, outX, outY);
+}
+
+void integrateScalar(const LayoutKernel::IntegrateParams& p, float* x, float* y, float* vx, float* vy,
+                     float* fx, float* fy, int count)
+{
+    for (int i = 0; i < count; i++) {
+        // Small pull toward the center so loose parts do not fly away.
+        float cx = p.centerX - x[i], cy = p.centerY - y[i];
+        float dist = sqrt(cx * cx + cy * cy);
+        if (dist > p.centerRadius) {
+            fx[i] += cx * (0.01f * (dist - p.centerRadius) / dist);
+            fy[i] += cy * (0.01f * (dist - p.centerRadius) / dist);
+        }
+
+        vx[i] = (vx[i] + fx[i]) * p.damping;
+        vy[i] = (vy[i] + fy[i]) * p.damping;
+        float speed = sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+        if (speed > p.maxSpeed) {
+            vx[i] *= p.maxSpeed / speed;
+            vy[i] *= p.maxSpeed / speed;
+        }
+        x[i] = clamp(x[i] + vx[i], p.minX, p.maxX);
+        y[i] = clamp(y[i] + vy[i], p.minY, p.maxY);
+        if (p.settling) {
+            vx[i] *= 0.95f;
+            vy[i] *= 0.95f;
+        }
+        fx[i] = 0;
+        fy[i] = 0;
+    }
+}
+
+#ifdef LAYOUT_KERNEL_X86
+TARGET_SSE2 inline float sum4(__m128 v)
+{
+    __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// ---- SSE2, 4 lanes ----
+
+TARGET_SSE2 void repelSse2(float px, float py, const float* xs, const float* ys, int count,
+                           float repulsion, float& ax, float& ay)
+{
+    const __m128 vpx = _mm_set1_ps(px), vpy = _mm_set1_ps(py);
+    const __m128 one = _mm_set1_ps(1.0f), cap = _mm_set1_ps(200.0f), rep = _mm_set1_ps(repulsion);
+    __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(vpx, _mm_loadu_ps(xs + i));
+        __m128 dy = _mm_sub_ps(vpy, _mm_loadu_ps(ys + i));
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 apart = _mm_cmpneq_ps(d2, _mm_setzero_ps());
+        d2 = _mm_max_ps(d2, one);
+        __m128 strength = _mm_min_ps(_mm_div_ps(rep, d2), cap);
+        __m128 scale = _mm_and_ps(_mm_div_ps(strength, _mm_sqrt_ps(d2)), apart);
+        sx = _mm_add_ps(sx, _mm_mul_ps(dx, scale));
+        sy = _mm_add_ps(sy, _mm_mul_ps(dy, scale));
+    }
+    float tx = sum4(sx), ty = sum4(sy);
+    for (; i < count; i++) repelOne(px - xs[i], py - ys[i], 1.0f, repulsion, tx, ty);
+    ax += tx;
+    ay += ty;
+}
+
+TARGET_SSE2 void springsSse2(const int* sources, const int* targets, const float* lengths, int count,
+                             const float* x, const float* y, float springK, float* outX, float* outY)
+{
+    const __m128 one = _mm_set1_ps(1.0f), k = _mm_set1_ps(-springK);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const int* s = sources + i;
+        const int* t = targets + i;
+        __m128 dx = _mm_sub_ps(_mm_setr_ps(x[s[0]], x[s[1]], x[s[2]], x[s[3]]),
+                               _mm_setr_ps(x[t[0]], x[t[1]], x[t[2]], x[t[3]]));
+        __m128 dy = _mm_sub_ps(_mm_setr_ps(y[s[0]], y[s[1]], y[s[2]], y[s[3]]),
+                               _mm_setr_ps(y[t[0]], y[t[1]], y[t[2]], y[t[3]]));
+        __m128 d = _mm_max_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+        __m128 spring = _mm_mul_ps(k, _mm_sub_ps(d, _mm_loadu_ps(lengths + i)));
+        __m128 scale = _mm_div_ps(spring, d);
+        _mm_storeu_ps(outX + i, _mm_mul_ps(dx, scale));
+        _mm_storeu_ps(outY + i, _mm_mul_ps(dy, scale));
+    }
+    for (; i < count; i++) springOne(i, sources, targets, lengths, x, y, springK, outX, outY);
+}
+
+TARGET_SSE2 void integrateSse2(const LayoutKernel::IntegrateParams& p, float* x, float* y, float* vx, float* vy,
+                               float* fx, float* fy, int count)
+{
+    const __m128 centerX = _mm_set1_ps(p.centerX), centerY = _mm_set1_ps(p.centerY);
+    const __m128 radius = _mm_set1_ps(p.centerRadius), pull = _mm_set1_ps(0.01f);
+    const __m128 damping = _mm_set1_ps(p.damping), maxSpeed = _mm_set1_ps(p.maxSpeed);
+    const __m128 minX = _mm_set1_ps(p.minX), maxX = _mm_set1_ps(p.maxX);
+    const __m128 minY = _mm_set1_ps(p.minY), maxY = _mm_set1_ps(p.maxY);
+    const __m128 one = _mm_set1_ps(1.0f), settle = _mm_set1_ps(p.settling ? 0.95f : 1.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+        __m128 cx = _mm_sub_ps(centerX, px), cy = _mm_sub_ps(centerY, py);
+        __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)));
+        // Lanes inside the radius are masked out, including their 0/0.
+        __m128 factor = _mm_div_ps(_mm_mul_ps(pull, _mm_sub_ps(dist, radius)), dist);
+        factor = _mm_and_ps(factor, _mm_cmpgt_ps(dist, radius));
+        __m128 ux = _mm_add_ps(_mm_loadu_ps(fx + i), _mm_mul_ps(cx, factor));
+        __m128 uy = _mm_add_ps(_mm_loadu_ps(fy + i), _mm_mul_ps(cy, factor));
+
+        ux = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), ux), damping);
+        uy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), uy), damping);
+        __m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uy, uy)));
+        __m128 fast = _mm_cmpgt_ps(speed, maxSpeed);
+        __m128 cap = _mm_or_ps(_mm_and_ps(fast, _mm_div_ps(maxSpeed, speed)), _mm_andnot_ps(fast, one));
+        ux = _mm_mul_ps(ux, cap);
+        uy = _mm_mul_ps(uy, cap);
+        _mm_storeu_ps(x + i, _mm_min_ps(_mm_max_ps(_mm_add_ps(px, ux), minX), maxX));
+        _mm_storeu_ps(y + i, _mm_min_ps(_mm_max_ps(_mm_add_ps(py, uy), minY), maxY));
+        _mm_storeu_ps(vx + i, _mm_mul_ps(ux, settle));
+        _mm_storeu_ps(vy + i, _mm_mul_ps(uy, settle));
+        _mm_storeu_ps(fx + i, _mm_setzero_ps());
+        _mm_storeu_ps(fy + i, _mm_setzero_ps());
+    }
+    integrateScalar(p, x + i, y + i, vx + i, vy + i, fx + i, fy + i, count - i);
+}
+
+// ---- AVX2, 8 lanes ----
+
+TARGET_AVX2 inline float sum8(__m256 v)
+{
+    return sum4(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_AVX2 inline void repelLanes(__m256 dx, __m256 dy, __m256 rep, __m256& sx, __m256& sy)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), cap = _mm256_set1_ps(200.0f);
+    __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    __m256 apart = _mm256_cmp_ps(d2, _mm256_setzero_ps(), _CMP_NEQ_OQ);
+    d2 = _mm256_max_ps(d2, one);
+    __m256 strength = _mm256_min_ps(_mm256_div_ps(rep, d2), cap);
+    __m256 scale = _mm256_and_ps(_mm256_div_ps(strength, _mm256_sqrt_ps(d2)), apart);
+    sx = _mm256_add_ps(sx, _mm256_mul_ps(dx, scale));
+    sy = _mm256_add_ps(sy, _mm256_mul_ps(dy, scale));
+}
+
+TARGET_AVX2 void repelAvx2(float px, float py, const float* xs, const float* ys, int count,
+                           float repulsion, float& ax, float& ay)
+{
+    const __m256 vpx = _mm256_set1_ps(px), vpy = _mm256_set1_ps(py), rep = _mm256_set1_ps(repulsion);
+    __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        repelLanes(_mm256_sub_ps(vpx, _mm256_loadu_ps(xs + i)), _mm256_sub_ps(vpy, _mm256_loadu_ps(ys + i)),
+                   rep, sx, sy);
+    }
+    if (i < count) {
+        // Masked loads for the rest of a leaf; lanes past the end read as the
+        // body itself, which repels nothing.
+        __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256 mask = _mm256_castsi256_ps(lanes);
+        __m256 bx = _mm256_blendv_ps(vpx, _mm256_maskload_ps(xs + i, lanes), mask);
+        __m256 by = _mm256_blendv_ps(vpy, _mm256_maskload_ps(ys + i, lanes), mask);
+        repelLanes(_mm256_sub_ps(vpx, bx), _mm256_sub_ps(vpy, by), rep, sx, sy);
+    }
+    ax += sum8(sx);
+    ay += sum8(sy);
+}
+
+TARGET_AVX2 void springsAvx2(const int* sources, const int* targets, const float* lengths, int count,
+                             const float* x, const float* y, float springK, float* outX, float* outY)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), k = _mm256_set1_ps(-springK);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(sources + i));
+        __m256i t = _mm256_loadu_si256((const __m256i*)(targets + i));
+        __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(x, s, 4), _mm256_i32gather_ps(x, t, 4));
+        __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(y, s, 4), _mm256_i32gather_ps(y, t, 4));
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 d = _mm256_max_ps(one, _mm256_sqrt_ps(d2));
+        __m256 spring = _mm256_mul_ps(k, _mm256_sub_ps(d, _mm256_loadu_ps(lengths + i)));
+        __m256 scale = _mm256_div_ps(spring, d);
+        _mm256_storeu_ps(outX + i, _mm256_mul_ps(dx, scale));
+        _mm256_storeu_ps(outY + i, _mm256_mul_ps(dy, scale));
+    }
+    for (; i < count; i++) springOne(i, sources, targets, lengths, x, y, springK, outX, outY);
+}
+
+TARGET_AVX2 void integrateAvx2(const LayoutKernel::IntegrateParams& p, float* x, float* y, float* vx, float* vy,
+                               float* fx, float* fy, int count)
+{
+    const __m256 centerX = _mm256_set1_ps(p.centerX), centerY = _mm256_set1_ps(p.centerY);
+    const __m256 radius = _mm256_set1_ps(p.centerRadius), pull = _mm256_set1_ps(0.01f);
+    const __m256 damping = _mm256_set1_ps(p.damping), maxSpeed = _mm256_set1_ps(p.maxSpeed);
+    const __m256 minX = _mm256_set1_ps(p.minX), maxX = _mm256_set1_ps(p.maxX);
+    const __m256 minY = _mm256_set1_ps(p.minY), maxY = _mm256_set1_ps(p.maxY);
+    const __m256 one = _mm256_set1_ps(1.0f), settle = _mm256_set1_ps(p.settling ? 0.95f : 1.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+        __m256 cx = _mm256_sub_ps(centerX, px), cy = _mm256_sub_ps(centerY, py);
+        __m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)));
+        __m256 factor = _mm256_div_ps(_mm256_mul_ps(pull, _mm256_sub_ps(dist, radius)), dist);
+        factor = _mm256_and_ps(factor, _mm256_cmp_ps(dist, radius, _CMP_GT_OQ));
+        __m256 ux = _mm256_add_ps(_mm256_loadu_ps(fx + i), _mm256_mul_ps(cx, factor));
+        __m256 uy = _mm256_add_ps(_mm256_loadu_ps(fy + i), _mm256_mul_ps(cy, factor));
+
+        ux = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vx + i), ux), damping);
+        uy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vy + i), uy), damping);
+        __m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ux, ux), _mm256_mul_ps(uy, uy)));
+        __m256 fast = _mm256_cmp_ps(speed, maxSpeed, _CMP_GT_OQ);
+        __m256 cap = _mm256_blendv_ps(one, _mm256_div_ps(maxSpeed, speed), fast);
+        ux = _mm256_mul_ps(ux, cap);
+        uy = _mm256_mul_ps(uy, cap);
+        _mm256_storeu_ps(x + i, _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(px, ux), minX), maxX));
+        _mm256_storeu_ps(y + i, _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(py, uy), minY), maxY));
+        _mm256_storeu_ps(vx + i, _mm256_mul_ps(ux, settle));
+        _mm256_storeu_ps(vy + i, _mm256_mul_ps(uy, settle));
+        _mm256_storeu_ps(fx + i, _mm256_setzero_ps());
+        _mm256_storeu_ps(fy + i, _mm256_setzero_ps());
+    }
+    integrateScalar(p, x + i, y + i, vx + i, vy + i, fx + i, fy + i, count - i);
+}
+
+bool cpuHas(bool avx2)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return avx2 ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("sse2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    if (!avx2) return (info[3] >> 26) & 1;
+    // AVX needs OS support for saving the ymm registers, too.
+    bool osxsave = (info[2] >> 27) & 1, avx = (info[2] >> 28) & 1;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] >> 5) & 1;
+#else
+    return !avx2;
+#endif
+}
+#endif
+
+const LayoutKernel scalarKernel{"scalar", repelScalar, springsScalar, integrateScalar};
+#ifdef LAYOUT_KERNEL_X86
+const LayoutKernel sse2Kernel{"sse2", repelSse2, springsSse2, integrateSse2};
+const LayoutKernel avx2Kernel{"avx2", repelAvx2, springsAvx2, integrateAvx2};
+#endif
+}
+
+const LayoutKernel& LayoutKernel::Scalar()
+{
+    return scalarKernel;
+}
+
+vector<const LayoutKernel*> LayoutKernel::Available()
+{
+    vector<const LayoutKernel*> kernels{&scalarKernel};
+#ifdef LAYOUT_KERNEL_X86
+    if (cpuHas(false)) kernels.push_back(&sse2Kernel);
+    if (cpuHas(true)) kernels.push_back(&avx2Kernel);
+#endif
+    return kernels;
+}
+
+const LayoutKernel& LayoutKernel::Best()
+{
+    static const LayoutKernel* best = Available().back();
+    return *best;
+}
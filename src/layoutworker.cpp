@@ -0,0 +1,98 @@
+#include "layoutworker.hpp"
+#include "tracer.hpp"
+
+LayoutWorker::~LayoutWorker()
+{
+    stop();
+}
+
+void LayoutWorker::start(shared_ptr<const Graph> g, const LayoutOptions& options, int frameEvery,
+                         Callback callback, shared_ptr<const Graph::LayoutPositions> previous)
+{
+    TRACE_SPAN("LayoutWorker::start");
+    cancel();
+    reap(false);
+
+    CancelToken token;
+    auto finished = make_shared<promise<void>>();
+    frameEvery = max(1, frameEvery);
+
+    Job job{token, finished->get_future().share()};
+    pool.submit([g, options, previous, token, finished, frameEvery, callback]() {
+        if (token.cancelled()) {
+            finished->set_value();
+            return;
+        }
+        GraphLayout layout(*g, options);
+        if (previous) layout.seed(*previous);
+        auto send = [&]() {
+            auto frame = make_shared<Frame>();
+            layout.fittedPositions(frame->x, frame->y);
+            frame->iteration = layout.iterationsDone();
+            callback(frame);
+        };
+        // Placing the coarse levels is most of a big layout's time.
+        layout.onLevel = [&]() {
+            if (token.cancelled()) return false;
+            send();
+            return true;
+        };
+        if (!token.cancelled()) send();
+
+        while (!layout.done() && !token.cancelled()) {
+            {
+                TRACE_SPAN("GraphLayout::step");
+                layout.step();
+            }
+            if (layout.iterationsDone() % frameEvery == 0 && !layout.done() && !token.cancelled()) send();
+        }
+        if (!token.cancelled()) {
+            layout.fitToView();
+            auto frame = make_shared<Frame>();
+            frame->result = layout.snapshot();
+            frame->x = std::move(layout.x);
+            frame->y = std::move(layout.y);
+            frame->iteration = layout.iterationsDone();
+            frame->finished = true;
+            callback(frame);
+        }
+        finished->set_value();
+    }, TaskPool::Background);
+    jobs.push_back(std::move(job));
+}
+
+void LayoutWorker::cancel()
+{
+    for (Job& job : jobs) job.token.cancel();
+}
+
+void LayoutWorker::stop()
+{
+    cancel();
+    reap(true);
+}
+
+bool LayoutWorker::running() const
+{
+    for (const Job& job : jobs) {
+        if (!isDone(job) && !job.token.cancelled()) return true;
+    }
+    return false;
+}
+
+void LayoutWorker::reap(bool wait)
+{
+    for (size_t i = 0; i < jobs.size();) {
+        if (wait || isDone(jobs[i])) {
+            jobs[i].finished.wait();
+            jobs.erase(jobs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+bool LayoutWorker::isDone(const Job& job)
+{
+    return job.finished.wait_for(chrono::seconds(0)) == future_status::ready;
+}
@@ -1,11 +1,17 @@
 #include "mainwindow.h"
 #include "mainform.h"
+#include "tracer.hpp"
 
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // --trace FILE, or $WASALNEY_TRACE, writes a Chrome trace at exit.
+    const QStringList args = a.arguments();
+    const int trace = args.indexOf("--trace");
+    if (trace >= 0 && trace + 1 < args.size()) Tracer::Start(args[trace + 1].toStdString());
+    else Tracer::StartFromEnvironment();
     MainForm w;
     w.show();
     return a.exec();
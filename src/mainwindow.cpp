@@ -1,13 +1,20 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "editgraph.h"
+#include "cityname.h"
+#include "tracer.hpp"
+#include <QTextCursor>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow),
-      animationTimer(nullptr)
+      animationTimer(nullptr),
+      layoutWorker(program.pool)
 {
     ui->setupUi(this);
+    mapScene = new MapScene(ui->graphicsView);
+    cityModel = new CityListModel(this);
+    cityModel->attach(ui->start);
 
     // Set focus border style for all widgets inside this form
     this->setStyleSheet(R"(
@@ -17,9 +24,12 @@ MainWindow::MainWindow(QWidget *parent)
         }
     )");
 
+    if (!program.f.lastError.empty()) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(program.f.lastError));
+    }
 
     for (const auto& graph : program.graphs) {
-        ui->MapSelectionCmb->addItem(QString::fromStdString(graph.name));
+        ui->MapSelectionCmb->addItem(QString::fromStdString(graph->name));
     }
     ui->MapSelectionCmb->setCurrentIndex(-1);
 
@@ -32,6 +42,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // No layout frame may be queued to a half destroyed window.
+    layoutWorker.stop();
     if (animationTimer) {
         animationTimer->stop();
         delete animationTimer;
@@ -47,19 +59,11 @@ void MainWindow::on_exploreButton_clicked()
         return;
     }
 
-    ExploreMap* exploreMap = new ExploreMap(&program, this);
+    ExploreMap* exploreMap = new ExploreMap(&program, cityModel, this);
     exploreMap->setAttribute(Qt::WA_DeleteOnClose);
     exploreMap->show();
 }
 
-float max(float a,double b)
-{
-    if(a>b)
-        return a;
-    else
-        return b;
-}
-
 void MainWindow::ShowMap(int index)
 {
 
@@ -67,221 +71,9 @@ void MainWindow::ShowMap(int index)
     if (index < 0 || index >= program.graphs.size() || !program.currentGraph) {
         return;
     }
-    cityNodes.clear();
-    edgeLines.clear();
-    program.currentGraph = &program.graphs[index];
-
-    QGraphicsScene* scene = new QGraphicsScene(this);
-    scene->setBackgroundBrush(Qt::black);
-    ui->graphicsView->setScene(scene);
-
-    // Force-directed layout setup
-    map<string, QPointF> positions;
-    map<string, QPointF> velocities;
-
-    // Initialize cities with spread-out positions
-    int cityCount = program.currentGraph->getAllCities().size();
-    if (cityCount > 0) {
-        // Create initial positions in a circle for better starting distribution
-        double radius = min(ui->graphicsView->width(), ui->graphicsView->height()) * 0.35;
-        double centerX = ui->graphicsView->width() / 2.0;
-        double centerY = ui->graphicsView->height() / 2.0;
-
-        int i = 0;
-        for (const auto& city : program.currentGraph->getAllCities()) {
-            // Position cities in a circle
-            double angle = 2.0 * M_PI * i / cityCount;
-            double x = centerX + radius * cos(angle);
-            double y = centerY + radius * sin(angle);
-            positions[city] = QPointF(x, y);
-            velocities[city] = QPointF(0, 0);
-            i++;
-        }
-    }
-
-    // Calculate the average edge distance to use for scaling
-    double totalDistance = 0.0;
-    int edgeCount = 0;
-    for (const auto& city : program.currentGraph->getAllCities()) {
-        for (const auto& [neighbor, edgeData] : program.currentGraph->adj[city]) {
-            totalDistance += edgeData.first;
-            edgeCount++;
-        }
-    }
-    double avgDistance = (edgeCount > 0) ? totalDistance / edgeCount : 100.0;
-    double distanceScale = 200.0 / avgDistance; // Scale factor to make average edge ~200px
-
-    // Run force-directed algorithm iterations
-    const int ITERATIONS = 150;
-    const double REPULSION = 10000.0;
-    const double SPRING_K = 0.002;
-    const double DAMPING = 0.85;
-
-    for (int iter = 0; iter < ITERATIONS; iter++) {
-        // Calculate forces for each node
-        map<string, QPointF> forces;
-
-        // Initialize forces to zero
-        for (const auto& city : program.currentGraph->getAllCities()) {
-            forces[city] = QPointF(0, 0);
-        }
-
-        // Apply repulsive forces between all nodes
-        for (const auto& city1 : program.currentGraph->getAllCities()) {
-            for (const auto& city2 : program.currentGraph->getAllCities()) {
-                if (city1 != city2) {
-                    QPointF delta = positions[city1] - positions[city2];
-                    double distance = sqrt(delta.x() * delta.x() + delta.y() * delta.y());
-                    if (distance < 1.0) distance = 1.0; // Avoid division by very small numbers
-
-                    // Repulsive force is inversely proportional to distance
-                    double repulsionStrength = REPULSION / (distance * distance);
-                    // Limit maximum repulsion
-                    repulsionStrength = min(repulsionStrength, 200.0);
-
-                    if (distance > 0) {
-                        QPointF repulsion = delta * (repulsionStrength / distance);
-                        forces[city1] += repulsion;
-                    }
-                }
-            }
-        }
-
-        // Apply spring forces for edges
-        for (const auto& city : program.currentGraph->getAllCities()) {
-            for (const auto& [neighbor, edgeData] : program.currentGraph->adj[city]) {
-                QPointF delta = positions[city] - positions[neighbor];
-                double distance = sqrt(delta.x() * delta.x() + delta.y() * delta.y());
-                if (distance < 1.0) distance = 1.0;
-
-                // Spring force proportional to difference between actual and desired distance
-                double edgeLength = edgeData.first;  // Distance in km
-                double idealDist = edgeLength * distanceScale;
-
-                // Apply nonlinear spring force
-                double springFactor = -SPRING_K * (distance - idealDist);
-                if (distance > 0) {
-                    QPointF spring = delta * (springFactor / distance);
-                    forces[city] += spring;
-                }
-            }
-        }
-
-        // Add a small force toward the center to prevent flying away
-        double centerX = ui->graphicsView->width() / 2.0;
-        double centerY = ui->graphicsView->height() / 2.0;
-        for (const auto& city : program.currentGraph->getAllCities()) {
-            QPointF toCenter = QPointF(centerX, centerY) - positions[city];
-            double dist = sqrt(toCenter.x() * toCenter.x() + toCenter.y() * toCenter.y());
-            if (dist > 300) { // Only apply if far from center
-                forces[city] += toCenter * (0.01 * (dist - 300) / dist);
-            }
-        }
-
-        // Update positions and velocities
-        double maxSpeed = (iter < ITERATIONS / 2) ? 10.0 : 5.0; // Lower max speed later
-        for (const auto& city : program.currentGraph->getAllCities()) {
-            velocities[city] = (velocities[city] + forces[city]) * DAMPING;
-
-            // Limit maximum velocity
-            double speed = sqrt(velocities[city].x() * velocities[city].x() +
-                                     velocities[city].y() * velocities[city].y());
-            if (speed > maxSpeed) {
-                velocities[city] *= (maxSpeed / speed);
-            }
-
-            positions[city] += velocities[city];
-
-            // Ensure nodes stay within bounds with some padding
-            double viewWidth = ui->graphicsView->width();
-            double viewHeight = ui->graphicsView->height();
-            double padding = 50.0;
-            positions[city].setX(max(padding, min(viewWidth - padding, positions[city].x())));
-            positions[city].setY(max(padding, min(viewHeight - padding, positions[city].y())));
-        }
-
-        // Slow things down in later iterations
-        if (iter > ITERATIONS * 0.7) {
-            for (auto& [city, vel] : velocities) {
-                vel *= 0.95;
-            }
-        }
-    }
-
-    // Scale the layout to fit better in the view
-    double minX = numeric_limits<double>::max();
-    double minY = numeric_limits<double>::max();
-    double maxX = numeric_limits<double>::lowest();
-    double maxY = numeric_limits<double>::lowest();
-
-    for (const auto& [city, pos] : positions) {
-        minX = min(minX, pos.x());
-        minY = min(minY, pos.y());
-        maxX = max(maxX, pos.x());
-        maxY = max(maxY, pos.y());
-    }
+    program.currentGraph = program.graphs[index];
+    refreshMap();
 
-    double scaleX = (maxX > minX) ? (ui->graphicsView->width() - 100) / (maxX - minX) : 1.0;
-    double scaleY = (maxY > minY) ? (ui->graphicsView->height() - 100) / (maxY - minY) : 1.0;
-    double scale = min(scaleX, scaleY);
-
-    // Apply scaling and centering if needed
-    if (scale < 0.9 || scale > 1.1) {
-        double centerX = (minX + maxX) / 2;
-        double centerY = (minY + maxY) / 2;
-        double viewCenterX = ui->graphicsView->width() / 2;
-        double viewCenterY = ui->graphicsView->height() / 2;
-
-        for (auto& [city, pos] : positions) {
-            // Center and scale
-            double newX = (pos.x() - centerX) * scale + viewCenterX;
-            double newY = (pos.y() - centerY) * scale + viewCenterY;
-            positions[city] = QPointF(newX, newY);
-        }
-    }
-
-    // Draw nodes (cities)
-    for (const auto& city : program.currentGraph->getAllCities()) {
-        QPointF pos = positions[city];
-        CityNode* node = new CityNode(QRectF(pos.x()-15, pos.y()-15, 30, 30), QString::fromStdString(city));
-        scene->addItem(node);
-        // Store reference to the city node
-        cityNodes[QString::fromStdString(city)] = node;
-        QGraphicsTextItem* label = scene->addText(QString::fromStdString(city));
-        label->setPos(pos.x() - label->boundingRect().width()/2, pos.y() + 20);
-    }
-
-    // Draw edges
-    set<pair<string, string>> drawn;
-    for (const auto& city : program.currentGraph->getAllCities()) {
-        for (const auto& [neighbor, edgeData] : program.currentGraph->adj[city]) {
-            if (drawn.count({neighbor, city}) == 0) {
-                QPointF from = positions[city];
-                QPointF to = positions[neighbor];
-                EdgeLine* edge = new EdgeLine(QLineF(from.x(), from.y(), to.x(), to.y()),
-                                              QString::fromStdString(city),
-                                              QString::fromStdString(neighbor));
-                scene->addItem(edge);
-                QString fromCity = QString::fromStdString(city);
-                QString toCity = QString::fromStdString(neighbor);
-                edgeLines[{fromCity, toCity}] = edge;
-                edgeLines[{toCity, fromCity}] = edge;
-                // Add distance label with offset
-                QPointF mid = (from + to) / 2;
-                QLineF line(from, to);
-                QLineF normal = line.normalVector();
-                normal.setLength(15);
-                QPointF labelPos = mid + QPointF(normal.dx(), normal.dy());
-
-                QGraphicsTextItem* distLabel = scene->addText(QString::number(edgeData.first) + " km");
-                distLabel->setPos(labelPos);
-                distLabel->setDefaultTextColor(Qt::white);
-
-                drawn.insert({city, neighbor});
-                drawn.insert({neighbor, city});
-            }
-        }
-    }
     // this is the timer for the animation
     if (!animationTimer) {
         animationTimer = new QTimer(this);
@@ -289,77 +81,166 @@ void MainWindow::ShowMap(int index)
     }
 }
 
+// Redraws the current graph after it changed: the scene only gets items for
+// what changed, and a cached layout makes the relayout incremental.
+void MainWindow::refreshMap()
+{
+    TRACE_SPAN("MainWindow::refreshMap");
+    if (!program.currentGraph) return;
 
-void MainWindow::resetGraphColors()
+    // Lay out a snapshot in the background; frames from a replaced layout
+    // are dropped.
+    const Graph& graph = *program.currentGraph;
+    shared_ptr<Graph> shown = program.currentGraph;
+    shared_ptr<const Graph> snapshot = Program::snapshot(shown);
+    if (!snapshot || snapshot->version != shown->version) snapshot = shown->snapshot();
+    LayoutOptions options;
+    options.width = ui->graphicsView->width();
+    options.height = ui->graphicsView->height();
+    // The cached layout shared with ExploreMap makes this instant when the
+    // graph did not change, and incremental after small edits.
+    int generation = ++layoutGeneration;
+    auto cached = atomic_load(&shown->layout);
+    layoutWorker.start(snapshot, options, LAYOUT_FRAME_EVERY,
+        [this, generation, shown](shared_ptr<const LayoutWorker::Frame> frame) {
+            QMetaObject::invokeMethod(this, [this, generation, shown, frame]() {
+                if (generation != layoutGeneration) return;
+                applyLayoutFrame(*frame);
+                if (frame->finished) program.storeLayout(shown, frame->result);
+            }, Qt::QueuedConnection);
+        },
+        cached);
+
+    // Cities and edges; the layout's first frame puts them in place, or the
+    // cached layout right away if it is for this version.
+    mapScene->sync(graph);
+    if (cached && cached->graphVersion == graph.version) mapScene->setPositions(cached->x, cached->y);
+}
+
+void MainWindow::applyLayoutFrame(const LayoutWorker::Frame& frame)
 {
-    for (auto node : cityNodes) {
-        node->highlight(Qt::cyan);
-    }
-    for (auto edge : edgeLines) {
-        edge->setPen(QPen(Qt::red, 3));
-    }
+    mapScene->setPositions(frame.x, frame.y);
 }
 
-void MainWindow::animateTraversal(const vector<string>& path)
+void MainWindow::resetGraphColors()
 {
+    mapScene->resetColors();
+}
 
-    animationPath.clear();
-    for (const auto& city : path) {
-        animationPath.append(QString::fromStdString(city));
-    }
+void MainWindow::animateTraversal(shared_ptr<const Graph> graph, Generator<Graph::TraversalEvent> events)
+{
+    TRACE_SPAN("MainWindow::animateTraversal");
+    stopTraversal();
     resetGraphColors();
-    currentAnimationStep = 0;
-    animationTimer->start(500);
+    ui->traversal->clear();
+    animationGraph = std::move(graph);
+    animationEvents = std::move(events);
+    animationTimer->start(ANIMATION_TICK_MS);
 }
 
 void MainWindow::animateTraversalStep()
 {
-    if (currentAnimationStep >= animationPath.size()) {
-        animationTimer->stop();
-        QTimer::singleShot(1000, this, &MainWindow::resetGraphColors);
-        return;
-    }
-
+    TRACE_SPAN("MainWindow::animateTraversalStep");
+    // At the end the colors stay, so it can still be stepped back through.
+    if (!stepForward()) animationTimer->stop();
+}
 
-    QString currentCity = animationPath[currentAnimationStep];
+// Applies the next event, pulling it from the search the first time. Only
+// the event's city and edge are repainted.
+bool MainWindow::stepForward()
+{
+    if (!animationGraph) return false;
+    if (currentAnimationStep == animationSteps.size()) {
+        if (!animationEvents.next()) return false;
+        AnimationStep step;
+        step.event = animationEvents.value();
+        step.city = QString::fromStdString(animationGraph->cityNames[step.event.city]);
+        if (step.event.from >= 0) step.from = QString::fromStdString(animationGraph->cityNames[step.event.from]);
+        animationSteps.push_back(step);
+    }
+
+    AnimationStep& step = animationSteps[currentAnimationStep++];
+    const bool visit = step.event.kind == Graph::TraversalEvent::Visit;
+    const QColor color = visit ? QColor(Qt::green) : QColor(255, 165, 0); // reached: orange
+    step.cityBefore = mapScene->cityColor(step.city);
+    mapScene->highlightCity(step.city, color);
+    if (!step.from.isEmpty()) {
+        step.edgeBefore = mapScene->edgeColor(step.from, step.city);
+        mapScene->highlightEdge(step.from, step.city, color);
+    }
+    if (visit) {
+        QString text = ui->traversal->document()->isEmpty() ? step.city : " --> " + step.city;
+        QTextCursor cursor(ui->traversal->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(text);
+        step.textAdded = text.size();
+    }
+    return true;
+}
 
+void MainWindow::stopTraversal()
+{
+    if (animationTimer) animationTimer->stop();
+    animationEvents.reset();
+    animationGraph.reset();
+    animationSteps.clear();
+    currentAnimationStep = 0;
+    ui->pauseTraversal->setText("Pause");
+}
 
-    if (cityNodes.contains(currentCity)) {
-        cityNodes[currentCity]->highlight(Qt::green);
+void MainWindow::on_pauseTraversal_clicked()
+{
+    if (!animationGraph) return;
+    if (animationTimer->isActive()) {
+        animationTimer->stop();
+        ui->pauseTraversal->setText("Resume");
+    } else {
+        ui->pauseTraversal->setText("Pause");
+        animationTimer->start(ANIMATION_TICK_MS);
     }
+}
 
-
-    if (currentAnimationStep > 0) {
-        QString prevCity = animationPath[currentAnimationStep - 1];
-        QPair<QString, QString> edge = {prevCity, currentCity};
-
-        if (edgeLines.contains(edge)) {
-            edgeLines[edge]->setPen(QPen(Qt::red, 3));
-        }
+void MainWindow::on_stepBack_clicked()
+{
+    if (currentAnimationStep == 0) return;
+    animationTimer->stop();
+    ui->pauseTraversal->setText("Resume");
+
+    const AnimationStep& step = animationSteps[--currentAnimationStep];
+    mapScene->highlightCity(step.city, step.cityBefore);
+    if (!step.from.isEmpty()) mapScene->highlightEdge(step.from, step.city, step.edgeBefore);
+    if (step.textAdded) {
+        QTextCursor cursor(ui->traversal->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor, step.textAdded);
+        cursor.removeSelectedText();
     }
+}
 
-    currentAnimationStep++;
+void MainWindow::on_cancelTraversal_clicked()
+{
+    stopTraversal();
+    resetGraphColors();
+    ui->traversal->clear();
 }
 
 void MainWindow::onMapSelectionChanged(int index)
 {
-    ui->start->clear();
+    stopTraversal();
     if (index < 0 || index >= program.graphs.size()) {
         program.currentGraph = nullptr;
-        if (ui->graphicsView->scene()) {
-            ui->graphicsView->scene()->clear();
-        }
+        cityModel->setGraph(nullptr);
+        layoutGeneration++;
+        layoutWorker.cancel();
+        mapScene->clear();
         return;
     }
 
-    program.currentGraph = &program.graphs[index];
+    program.currentGraph = program.graphs[index];
+    cityModel->setGraph(program.currentGraph.get());
     ShowMap(index);
 
-    ui->start->clear();
     ui->traversal->clear();
-    for (const auto& city : program.currentGraph->getAllCities()) {
-        ui->start->addItem(QString::fromStdString(city));
-    }
     ui->start->setCurrentIndex(-1);
 }
 
@@ -382,7 +263,7 @@ void MainWindow::on_addGraphButton_clicked()
         int index = ui->MapSelectionCmb->findText(name);
         if (index >= 0) {
             ui->MapSelectionCmb->setCurrentIndex(index);
-            program.currentGraph = &program.graphs[index];
+            program.currentGraph = program.graphs[index];
             ShowMap(index);
         }
 
@@ -394,15 +275,17 @@ void MainWindow::updateGraphComboBox() {
     ui->MapSelectionCmb->clear();
 
     for (const auto& g : program.graphs) {
-        ui->MapSelectionCmb->addItem(QString::fromStdString(g.name));
+        ui->MapSelectionCmb->addItem(QString::fromStdString(g->name));
     }
 
     ui->MapSelectionCmb->setCurrentIndex(-1);
     program.currentGraph = nullptr;
+    cityModel->setGraph(nullptr);
 
-    if (ui->graphicsView->scene()) {
-        ui->graphicsView->scene()->clear();
-    }
+    stopTraversal();
+    layoutGeneration++;
+    layoutWorker.cancel();
+    mapScene->clear();
 }
 
 void MainWindow::on_deleteGraphButton_clicked()
@@ -425,6 +308,25 @@ void MainWindow::on_deleteGraphButton_clicked()
     }
 }
 
+void MainWindow::on_importGraphButton_clicked()
+{
+    QString path = QFileDialog::getOpenFileName(this, tr("Import Map"), QString(),
+                                                tr("Road networks (*.gr *.csv *.tsv *.txt);;All files (*)"));
+    if (path.isEmpty()) return;
+
+    string error;
+    if (!program.importGraph(path.toStdString(), error)) {
+        QMessageBox::critical(this, "Import Failed", QString::fromStdString(error));
+        return;
+    }
+    QString name = QString::fromStdString(program.graphs.back()->name);
+    updateGraphComboBox();
+    int index = ui->MapSelectionCmb->findText(name);
+    if (index >= 0) {
+        ui->MapSelectionCmb->setCurrentIndex(index);
+    }
+}
+
 void MainWindow::on_BFS_clicked()
 {
     if (!program.currentGraph) return;
@@ -433,20 +335,12 @@ void MainWindow::on_BFS_clicked()
         QMessageBox::warning(this, "Input Error", "Start cannot be empty.");
         return;
     }
-    auto graph = program.currentGraph->BFS(start.toStdString());
-    if (graph.empty()) {
+    int startId = program.currentGraph->cityId(CityName(start));
+    if (startId < 0) {
         ui->traversal->setText("No path found.");
         return;
     }
-    QString result;
-    for (size_t i = 0; i < graph.size(); ++i) {
-        result += QString::fromStdString(graph[i]);
-        if (i + 1 < graph.size())
-            result += " --> ";
-    }
-    ui->traversal->setText(result);
-
-    animateTraversal(graph);
+    animateTraversal(program.currentGraph, program.currentGraph->BFSSteps(startId));
 }
 
 void MainWindow::on_DFS_clicked()
@@ -457,21 +351,29 @@ void MainWindow::on_DFS_clicked()
         QMessageBox::warning(this, "Input Error", "Start cannot be empty.");
         return;
     }
-    auto graph = program.currentGraph->DFS(start.toStdString());
-    if (graph.empty()) {
+    int startId = program.currentGraph->cityId(CityName(start));
+    if (startId < 0) {
         ui->traversal->setText("No path found.");
         return;
     }
+    animateTraversal(program.currentGraph, program.currentGraph->DFSSteps(startId));
+}
 
-    // Display the path in text format
-    QString result;
-    for (size_t i = 0; i < graph.size(); ++i) {
-        result += QString::fromStdString(graph[i]);
-        if (i + 1 < graph.size())
-            result += " --> ";
+void MainWindow::on_dijkstra_clicked()
+{
+    if (!program.currentGraph) return;
+    QString start = ui->start->currentText();
+    if (start.isEmpty()) {
+        QMessageBox::warning(this, "Input Error", "Start cannot be empty.");
+        return;
     }
-    ui->traversal->setText(result);
-    animateTraversal(graph);
+    int startId = program.currentGraph->cityId(CityName(start));
+    if (startId < 0) {
+        ui->traversal->setText("No path found.");
+        return;
+    }
+    // Settles every reachable city, by distance.
+    animateTraversal(program.currentGraph, program.currentGraph->DijkstraSteps(startId, false));
 }
 
 void MainWindow::on_editGraph_clicked(){
@@ -481,10 +383,11 @@ void MainWindow::on_editGraph_clicked(){
         return;
     }
 
-    editGraph* edit = new editGraph(&program, this);
+    editGraph* edit = new editGraph(&program, cityModel, this);
     edit->setAttribute(Qt::WA_DeleteOnClose);
     edit->show();
 
+    connect(edit, &editGraph::graphChanged, this, &MainWindow::refreshMap);
     connect(edit, &QObject::destroyed, this, [=]() {
         ui->editGraph->setEnabled(true);
     });
@@ -492,7 +395,10 @@ void MainWindow::on_editGraph_clicked(){
 
 void MainWindow::on_saveBtn_clicked()
 {
-    program.saveGraphs();
+    if (!program.saveGraphs()) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(program.f.lastError));
+        return;
+    }
     this->close();
 }
 
@@ -511,7 +417,11 @@ void MainWindow::closeEvent(QCloseEvent *event)
         );
 
     if (reply == QMessageBox::Yes) {
-        program.saveGraphs();
+        if (!program.saveGraphs()) {
+            QMessageBox::critical(this, "Error", QString::fromStdString(program.f.lastError));
+            event->ignore();
+            return;
+        }
         event->accept();
     } else {
 
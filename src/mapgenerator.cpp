@@ -0,0 +1,281 @@
+#include "mapgenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+const double GAP = 10.0; // km between components
+const double PI = 3.14159265358979323846;
+
+uint64_t mix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Uniform in [0, 1) from a hash, for values that are looked up by id rather
+// than drawn in order.
+double hashUnit(uint64_t seed, long long id, uint64_t salt)
+{
+    return (mix64(seed ^ mix64(uint64_t(id) * 4 + salt)) >> 11) * 0x1.0p-53;
+}
+
+long long ceilSqrt(long long n)
+{
+    long long s = (long long)sqrt((double)n);
+    while (s * s < n) s++;
+    while (s > 1 && (s - 1) * (s - 1) >= n) s--;
+    return s;
+}
+}
+
+// Draws from mt19937_64, which the standard specifies exactly, with our own
+// conversions, so a seed gives the same map with every standard library.
+class MapGenerator::Random
+{
+public:
+    explicit Random(uint64_t seed) : engine(seed) {}
+    double unit() { return (engine() >> 11) * 0x1.0p-53; } // [0, 1)
+    double uniform(double a, double b) { return a + (b - a) * unit(); }
+    double normal()
+    {
+        double u = 1.0 - unit(); // (0, 1]
+        return sqrt(-2.0 * log(u)) * cos(2 * PI * unit());
+    }
+
+private:
+    mt19937_64 engine;
+};
+
+bool MapGenerator::ParseTopology(const string& text, Topology& topology)
+{
+    if (text == "grid") topology = Grid;
+    else if (text == "geometric") topology = Geometric;
+    else if (text == "scalefree") topology = ScaleFree;
+    else if (text == "road") topology = Road;
+    else return false;
+    return true;
+}
+
+bool MapGenerator::ParseWeights(const string& text, Weights& weights)
+{
+    size_t colon = text.find(':');
+    string kind = text.substr(0, colon);
+    double values[2] = {0, 0};
+    int count = 0;
+    while (colon != string::npos && count < 2) {
+        size_t next = text.find(':', colon + 1);
+        string field = text.substr(colon + 1, next == string::npos ? string::npos : next - colon - 1);
+        char* end = nullptr;
+        values[count++] = strtod(field.c_str(), &end);
+        if (field.empty() || *end) return false;
+        colon = next;
+    }
+    if (colon != string::npos) return false;
+
+    if (kind == "euclidean" && count == 0) weights.kind = Weights::Euclidean;
+    else if (kind == "uniform" && count == 2 && values[0] > 0 && values[1] >= values[0]) weights.kind = Weights::Uniform;
+    else if (kind == "normal" && count == 2 && values[0] > 0 && values[1] >= 0) weights.kind = Weights::Normal;
+    else if (kind == "exponential" && count == 1 && values[0] > 0) weights.kind = Weights::Exponential;
+    else return false;
+    weights.a = values[0];
+    weights.b = values[1];
+    return true;
+}
+
+void MapGenerator::Run(const CityCallback& cityCallback, const EdgeCallback& edgeCallback)
+{
+    city = cityCallback ? cityCallback : [](long long, double, double, bool) {};
+    edge = edgeCallback ? edgeCallback : [](long long, long long, double, double) {};
+
+    const long long total = max(0LL, options.cities);
+    const long long components = min<long long>(max(1, options.components), max(1LL, total));
+    long long first = 0;
+    double x0 = 0;
+    for (long long k = 0; k < components && first < total; k++) {
+        long long count = total / components + (k < total % components ? 1 : 0);
+        Random random(mix64(options.seed) ^ mix64(uint64_t(k) + 1));
+        double width = 0;
+        if (count == 1) {
+            city(first, x0, 0, true);
+        } else if (options.topology == Geometric) {
+            width = geometric(first, count, x0, random);
+        } else if (options.topology == ScaleFree) {
+            width = scaleFree(first, count, x0, random);
+        } else {
+            width = grid(first, count, x0, random, options.topology == Road);
+        }
+        first += count;
+        x0 += width + GAP;
+    }
+}
+
+double MapGenerator::distance(double length, Random& random) const
+{
+    const Weights& w = options.distance;
+    double d = length;
+    if (w.kind == Weights::Uniform) d = random.uniform(w.a, w.b);
+    else if (w.kind == Weights::Normal) d = w.a + w.b * random.normal();
+    else if (w.kind == Weights::Exponential) d = -w.a * log(1.0 - random.unit());
+    return max(d, 0.001);
+}
+
+void MapGenerator::emit(long long u, long long v, double distance, double speed)
+{
+    edge(u, v, distance, distance / speed);
+}
+
+// Row major lattice. Roads: every city is jittered, vertical streets are all
+// kept (with row 0, an arterial, they keep the map connected) and 40% of the
+// local horizontal ones are dropped.
+double MapGenerator::grid(long long first, long long count, double x0, Random& random, bool road)
+{
+    const long long width = ceilSqrt(count);
+    const double jitter = road ? 0.3 : 0.0;
+    auto x = [&](long long id) { return x0 + id % width + jitter * (2 * hashUnit(options.seed, first + id, 0) - 1); };
+    auto y = [&](long long id) { return id / width + jitter * (2 * hashUnit(options.seed, first + id, 1) - 1); };
+    // Road class speeds by line index: highway, arterial, local street.
+    auto speed = [&](long long line) {
+        if (!road) return random.uniform(options.minSpeed, options.maxSpeed);
+        if (line % 32 == 0) return random.uniform(90, 120);
+        if (line % 8 == 0) return random.uniform(60, 80);
+        return random.uniform(30, 50);
+    };
+    auto connect = [&](long long u, long long v, long long line) {
+        double length = hypot(x(u) - x(v), y(u) - y(v));
+        if (road) length *= random.uniform(1.0, 1.3); // streets are not straight
+        double s = speed(line);
+        double d = distance(length, random);
+        emit(first + u, first + v, d, s);
+    };
+
+    for (long long id = 0; id < count; id++) {
+        const long long row = id / width, column = id % width;
+        city(first + id, x(id), y(id), false);
+        if (column + 1 < width && id + 1 < count) {
+            bool keep = !road || row % 8 == 0 || random.unit() < 0.6;
+            if (keep) connect(id, id + 1, row);
+        }
+        if (id + width < count) connect(id, id + width, column);
+    }
+    return (double)width;
+}
+
+// Random geometric graph, generated cell by cell in rows, keeping only the
+// previous row of cells. Cells are at least the radius wide, so only the 8
+// surrounding cells can hold neighbours. Each cell gets the same number of
+// points (give or take one), and a few extra edges, each at most a cell
+// diagonal long, chain the points of a cell and join each cell to the one
+// before it, so the graph is connected.
+double MapGenerator::geometric(long long first, long long count, double x0, Random& random)
+{
+    struct Point {
+        long long id;
+        double x, y;
+    };
+    const double degree = options.degree > 0 ? options.degree : 6;
+    const double side = sqrt((double)count);
+    const double radius = side * sqrt(degree / (PI * count));
+    const long long cells = max(1LL, min((long long)(side / radius), (long long)sqrt((double)count)));
+    const double cellSize = side / cells;
+    const double r2 = radius * radius;
+    const long long perCell = count / (cells * cells), extra = count % (cells * cells);
+
+    auto join = [&](const Point& p, const Point& q) {
+        double d = distance(hypot(p.x - q.x, p.y - q.y), random);
+        emit(p.id, q.id, d, random.uniform(options.minSpeed, options.maxSpeed));
+    };
+    auto near = [&](const Point& p, const Point& q) {
+        return (p.x - q.x) * (p.x - q.x) + (p.y - q.y) * (p.y - q.y) <= r2;
+    };
+
+    vector<vector<Point>> previous(cells), current(cells);
+    long long next = first;
+    for (long long cy = 0; cy < cells; cy++) {
+        for (long long cx = 0; cx < cells; cx++) {
+            vector<Point>& cell = current[cx];
+            cell.clear();
+            long long n = perCell + (cy * cells + cx < extra ? 1 : 0);
+            for (long long i = 0; i < n; i++) {
+                Point p{next++, x0 + (cx + random.unit()) * cellSize, (cy + random.unit()) * cellSize};
+                city(p.id, p.x, p.y, false);
+                for (const Point& q : cell) {
+                    if (near(p, q)) join(p, q);
+                }
+                if (!cell.empty() && !near(p, cell.back())) join(p, cell.back());
+                cell.push_back(p);
+            }
+
+            const vector<Point>* neighbours[4] = {
+                cx > 0 ? &current[cx - 1] : nullptr,
+                cy > 0 && cx > 0 ? &previous[cx - 1] : nullptr,
+                cy > 0 ? &previous[cx] : nullptr,
+                cy > 0 && cx + 1 < cells ? &previous[cx + 1] : nullptr,
+            };
+            for (const vector<Point>* other : neighbours) {
+                if (!other) continue;
+                for (const Point& p : cell) {
+                    for (const Point& q : *other) {
+                        if (near(p, q)) join(p, q);
+                    }
+                }
+            }
+            const vector<Point>* anchor = neighbours[0] ? neighbours[0] : neighbours[2];
+            if (anchor && !near(cell.front(), anchor->front())) join(cell.front(), anchor->front());
+        }
+        swap(previous, current);
+    }
+    return side;
+}
+
+// Chung-Lu graph: cities u < v are joined with probability w(u) w(v) / sum w
+// for power law weights w(i) ~ (i + 1)^(-1 / (2.5 - 1)), walked with the
+// geometric skips of Miller and Hagberg so the cost is linear in the edges.
+// A random recursive tree (each city joined to a hashed earlier one)
+// underneath keeps it connected and uses two of the average degree.
+// Positions are hashed too, so nothing per city is stored.
+double MapGenerator::scaleFree(long long first, long long count, double x0, Random& random)
+{
+    const double degree = options.degree > 0 ? options.degree : 4;
+    const double side = sqrt((double)count);
+    const double exponent = 1.0 / (2.5 - 1.0);
+    auto x = [&](long long id) { return x0 + side * hashUnit(options.seed, first + id, 2); };
+    auto y = [&](long long id) { return side * hashUnit(options.seed, first + id, 3); };
+    auto parent = [&](long long v) { return (long long)(mix64(options.seed ^ mix64(uint64_t(first + v) * 4 + 4)) % uint64_t(v)); };
+    auto connect = [&](long long u, long long v) {
+        double d = distance(hypot(x(u) - x(v), y(u) - y(v)), random);
+        emit(first + u, first + v, d, random.uniform(options.minSpeed, options.maxSpeed));
+    };
+
+    for (long long id = 0; id < count; id++) city(first + id, x(id), y(id), false);
+    for (long long v = 1; v < count; v++) connect(v, parent(v));
+
+    const double extra = max(0.0, degree - 2.0);
+    if (extra <= 0) return side;
+    double sum = 0;
+    for (long long i = 0; i < count; i++) sum += pow(double(i + 1), -exponent);
+    const double scale = extra * count / sum, total = extra * count;
+    auto weight = [&](long long i) { return scale * pow(double(i + 1), -exponent); };
+
+    for (long long u = 0; u + 1 < count; u++) {
+        const double wu = weight(u);
+        long long v = u + 1;
+        double p = min(1.0, wu * weight(v) / total);
+        while (v < count && p > 0) {
+            if (p < 1) {
+                double skip = floor(log(1.0 - random.unit()) / log1p(-p));
+                if (skip >= double(count - v)) break;
+                v += (long long)skip;
+            }
+            double q = min(1.0, wu * weight(v) / total);
+            if (random.unit() < q / p && parent(v) != u) connect(u, v);
+            p = q;
+            v++;
+        }
+    }
+    return side;
+}
@@ -0,0 +1,321 @@
+#include "mapscene.h"
+#include "tracer.hpp"
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+
+MapScene::MapScene(QGraphicsView* view)
+    : QObject(view), view(view), scene(new QGraphicsScene(this))
+{
+    scene->setBackgroundBrush(Qt::black);
+    edges = new EdgeBatch();
+    scene->addItem(edges);
+    clusters = new ClusterLayer();
+    clusters->setVisible(false);
+    clusters->onClicked = [this](const QRectF& area) {
+        this->view->fitInView(area, Qt::KeepAspectRatio);
+        updateLevelOfDetail();
+    };
+    scene->addItem(clusters);
+
+    view->setScene(scene);
+    view->setDragMode(QGraphicsView::ScrollHandDrag);
+    view->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+    view->viewport()->installEventFilter(this);
+}
+
+void MapScene::sync(const Graph& g, bool byTime)
+{
+    TRACE_SPAN("MapScene::sync");
+    if (&g != shownGraph) {
+        view->resetTransform();
+        shownGraph = &g;
+    } else if (byTime == shownByTime && syncChanges(g)) {
+        synced = g.logPosition();
+        return;
+    }
+    shownByTime = byTime;
+    synced = g.logPosition();
+
+    // Cities: reuse the items of names already shown, so a single edit adds
+    // or deletes at most one city's items.
+    QHash<QString, CityItems> previous;
+    previous.swap(cities);
+    idByName.clear();
+    ids.clear();
+    cityIndex.clear(); // ids may have changed; rebuilt by the next setPositions()
+    byId.assign(g.idCount(), CityItems{nullptr, nullptr});
+    for (int id = 0; id < g.idCount(); id++) {
+        if (!g.isCity(id)) continue;
+        QString city = QString::fromStdString(g.cityNames[id]);
+        auto it = previous.find(city);
+        CityItems items;
+        if (it != previous.end()) {
+            items = *it;
+            previous.erase(it);
+        } else {
+            items = addCityItems(city);
+        }
+        cities.insert(city, items);
+        idByName.insert(city, id);
+        byId[id] = items;
+        ids.push_back(id);
+    }
+    for (const CityItems& gone : previous) {
+        delete gone.node; // removes it from the scene
+        delete gone.label;
+    }
+
+    // Each undirected edge once, from its lower id end; the batch keeps the
+    // highlight of edges it already had.
+    vector<EdgeBatch::Edge> list;
+    for (int id = 0; id < g.idCount(); id++) {
+        for (const Graph::Edge& e : g.adj[id]) {
+            if (e.to > id) list.push_back(edgeItem(g, id, e));
+        }
+    }
+    edges->setEdges(std::move(list));
+}
+
+bool MapScene::syncChanges(const Graph& g)
+{
+    // Beyond this many changes reading the whole graph is about as cheap.
+    const size_t limit = 64 + ids.size() / 4;
+    vector<int> touched;
+    vector<pair<int, int>> touchedEdges;
+    if (!g.changedSince(synced, limit, touched, touchedEdges)) return false;
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+    sort(touchedEdges.begin(), touchedEdges.end());
+    touchedEdges.erase(unique(touchedEdges.begin(), touchedEdges.end()), touchedEdges.end());
+
+    // What a touched id shows is compared with what it holds now. Removals
+    // go first, so a name that moved to another id is free again.
+    if (byId.size() < (size_t)g.idCount()) byId.resize(g.idCount(), CityItems{nullptr, nullptr});
+    for (int id : touched) {
+        CityItems& items = byId[id];
+        if (!items.node || (g.isCity(id) && items.node->cityName == QString::fromStdString(g.cityNames[id])))
+            continue;
+        cities.remove(items.node->cityName);
+        idByName.remove(items.node->cityName);
+        delete items.node;
+        delete items.label;
+        items = CityItems{nullptr, nullptr};
+        ids.erase(lower_bound(ids.begin(), ids.end(), id));
+        cityIndex.clear();
+    }
+    for (int id : touched) {
+        if (byId[id].node || !g.isCity(id)) continue;
+        QString city = QString::fromStdString(g.cityNames[id]);
+        byId[id] = addCityItems(city);
+        cities.insert(city, byId[id]);
+        idByName.insert(city, id);
+        ids.insert(lower_bound(ids.begin(), ids.end(), id), id);
+        cityIndex.clear();
+    }
+
+    for (auto [u, v] : touchedEdges) {
+        if (const Graph::Edge* e = g.findEdge(u, v)) edges->setEdge(edgeItem(g, u, *e));
+        else edges->removeEdge(u, v);
+    }
+    return true;
+}
+
+MapScene::CityItems MapScene::addCityItems(const QString& city)
+{
+    CityItems items;
+    items.node = new CityNode(QRectF(-15, -15, 30, 30), city);
+    items.node->setVisible(detail != Detail::Clusters);
+    scene->addItem(items.node);
+    items.label = scene->addText(city);
+    items.label->setVisible(detail == Detail::Labels);
+    return items;
+}
+
+EdgeBatch::Edge MapScene::edgeItem(const Graph& g, int from, const Graph::Edge& e) const
+{
+    return {from, e.to, QString::fromStdString(g.cityNames[from]), QString::fromStdString(g.cityNames[e.to]),
+            QString::number(shownByTime ? e.time : e.distance) + (shownByTime ? " hrs" : " km")};
+}
+
+void MapScene::setPositions(const vector<float>& x, const vector<float>& y)
+{
+    TRACE_SPAN("MapScene::setPositions");
+    if (x.size() < byId.size() || y.size() < byId.size()) return; // from an older graph
+    float minX = 0, maxX = 0, minY = 0, maxY = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        int id = ids[i];
+        QPointF pos(x[id], y[id]);
+        byId[id].node->setRect(pos.x() - 15, pos.y() - 15, 30, 30);
+        QGraphicsTextItem* label = byId[id].label;
+        label->setPos(pos.x() - label->boundingRect().width() / 2, pos.y() + 20);
+        minX = i ? min(minX, x[id]) : x[id];
+        maxX = i ? max(maxX, x[id]) : x[id];
+        minY = i ? min(minY, y[id]) : y[id];
+        maxY = i ? max(maxY, y[id]) : y[id];
+    }
+    edges->setPositions(x, y);
+    clusters->setPositions(x, y, ids);
+    if (cityIndex.size() == 0) {
+        cityIndex.build(x, y, ids);
+    } else {
+        for (int id : ids) cityIndex.update(id, x[id], y[id]);
+    }
+
+    // Spacing of cities spread evenly over their bounding box.
+    if (!ids.empty()) spacing = sqrt(max(1.0f, maxX - minX) * max(1.0f, maxY - minY) / ids.size());
+    updateLevelOfDetail();
+}
+
+void MapScene::clear()
+{
+    for (const CityItems& items : cities) {
+        delete items.node;
+        delete items.label;
+    }
+    cities.clear();
+    idByName.clear();
+    ids.clear();
+    byId.clear();
+    cityIndex.clear();
+    edges->setEdges({});
+    clusters->setPositions({}, {}, {});
+    shownGraph = nullptr;
+    synced = Graph::LogPosition();
+    spacing = 0;
+}
+
+void MapScene::updateLevelOfDetail()
+{
+    const qreal zoom = view->transform().m11();
+    const qreal onScreen = spacing * zoom;
+    Detail wanted = Detail::Clusters;
+    if (ids.size() <= 1 || onScreen >= LABEL_MIN_SPACING) wanted = Detail::Labels;
+    else if (onScreen >= NODE_MIN_SPACING) wanted = Detail::Cities;
+    if (wanted == Detail::Clusters) clusters->setCellSize(CLUSTER_CELL / zoom);
+    if (wanted == detail) return;
+
+    detail = wanted;
+    const bool showCities = detail != Detail::Clusters;
+    const bool showLabels = detail == Detail::Labels;
+    for (const CityItems& items : cities) {
+        items.node->setVisible(showCities);
+        items.label->setVisible(showLabels);
+    }
+    edges->setLabelsVisible(showLabels);
+    clusters->setVisible(!showCities);
+}
+
+void MapScene::highlightCity(const QString& name, const QColor& color)
+{
+    auto it = cities.find(name);
+    if (it != cities.end()) it->node->highlight(color);
+}
+
+void MapScene::highlightEdge(const QString& from, const QString& to, const QColor& color)
+{
+    if (!idByName.contains(from) || !idByName.contains(to)) return;
+    edges->setColor(edges->find(idByName[from], idByName[to]), color);
+}
+
+void MapScene::resetColors()
+{
+    for (const CityItems& items : cities) items.node->highlight(Qt::cyan);
+    edges->resetColors();
+}
+
+QColor MapScene::cityColor(const QString& name) const
+{
+    auto it = cities.find(name);
+    return it == cities.end() ? QColor() : it->node->brush().color();
+}
+
+QColor MapScene::edgeColor(const QString& from, const QString& to) const
+{
+    if (!idByName.contains(from) || !idByName.contains(to)) return QColor();
+    return edges->color(edges->find(idByName[from], idByName[to]));
+}
+
+QString MapScene::cityAt(const QPointF& pos, qreal maxDistance) const
+{
+    int id = cityIndex.nearest((float)pos.x(), (float)pos.y(), (float)maxDistance);
+    return id < 0 ? QString() : byId[id].node->cityName;
+}
+
+QStringList MapScene::citiesIn(const QPolygonF& area) const
+{
+    vector<float> px, py;
+    for (const QPointF& p : area) {
+        px.push_back((float)p.x());
+        py.push_back((float)p.y());
+    }
+    QStringList names;
+    for (int id : cityIndex.inPolygon(px, py)) names.append(byId[id].node->cityName);
+    return names;
+}
+
+bool MapScene::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched != view->viewport()) return QObject::eventFilter(watched, event);
+
+    switch (event->type()) {
+    case QEvent::Wheel: {
+        const qreal factor = pow(1.0015, static_cast<QWheelEvent*>(event)->angleDelta().y());
+        view->scale(factor, factor);
+        updateLevelOfDetail();
+        return true;
+    }
+    case QEvent::MouseButtonPress: {
+        QMouseEvent* mouse = static_cast<QMouseEvent*>(event);
+        if (mouse->button() != Qt::LeftButton) break;
+        const QPointF pos = view->mapToScene(mouse->pos());
+        if (mouse->modifiers() & Qt::ShiftModifier) {
+            QPainterPath path(pos);
+            lasso = scene->addPath(path, QPen(Qt::yellow, 0, Qt::DashLine));
+            lasso->setZValue(2);
+            return true; // no panning while drawing
+        }
+        pressPos = mouse->pos();
+        break; // goes on to pan or select; a release in place is a click
+    }
+    case QEvent::MouseMove:
+        if (lasso) {
+            QPainterPath path = lasso->path();
+            path.lineTo(view->mapToScene(static_cast<QMouseEvent*>(event)->pos()));
+            lasso->setPath(path);
+            return true;
+        }
+        break;
+    case QEvent::MouseButtonRelease:
+        if (lasso) {
+            QStringList selected = citiesIn(lasso->path().toFillPolygon());
+            delete lasso;
+            lasso = nullptr;
+            scene->clearSelection();
+            for (const QString& city : selected) cities[city].node->setSelected(true);
+            if (onLasso) onLasso(selected);
+            return true;
+        }
+        if (static_cast<QMouseEvent*>(event)->button() == Qt::LeftButton &&
+            (static_cast<QMouseEvent*>(event)->pos() - pressPos).manhattanLength() <= CLICK_SLOP) {
+            // A city under the click wins, then an edge next to it, and
+            // otherwise the click snaps to the nearest city.
+            const QPointF pos = view->mapToScene(pressPos);
+            QString city = cityAt(pos, CITY_RADIUS);
+            if (city.isEmpty() && onEdgeClicked) {
+                int edge = edges->edgeAt(pos, EDGE_CLICK_SLOP / view->transform().m11());
+                if (edge >= 0) {
+                    onEdgeClicked(edges->edge(edge).fromCity, edges->edge(edge).toCity);
+                    break;
+                }
+            }
+            if (city.isEmpty()) city = cityAt(pos);
+            if (!city.isEmpty() && onCityClicked) onCityClicked(city);
+        }
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
@@ -1,29 +1,197 @@
 #include "program.hpp"
+#include "graphimporter.hpp"
+#include "indexstore.hpp"
+#include "graphlayout.hpp"
+#include "tracer.hpp"
+#include <cmath>
+#include <cstdlib>
 
-Program::Program() {
+Program::Program(const string& mapFile, unsigned threads, bool writeIndexes)
+    : mapFile(mapFile), writeIndexes(writeIndexes), pool(threads) {
     loadGraphs(); // Load graphs during initialization
 }
 
-void Program::loadGraphs() {
-    f.ReadGraphFromFile("C:\\Users\\Youssef Elshemy\\source\\repos\\wasalney_mini_Path_Finder\\filename.txt");
-    graphs = f.graphs;
+string Program::DefaultMapFile() {
+    const char* env = getenv("WASALNEY_MAP");
+    return env && *env ? env : "filename.txt";
 }
-void Program::saveGraphs()
+
+bool Program::loadGraphs() {
+    TRACE_SPAN("Program::loadGraphs");
+    bool ok = f.ReadGraphFromFile(mapFile, graphs);
+    for (const auto& g : graphs) {
+        loadIndex(g);
+        publish(g);
+    }
+    return ok;
+}
+bool Program::saveGraphs()
+{
+    if (!f.SaveInFile(mapFile, graphs)) return false;
+    for (const auto& g : graphs) {
+        auto index = atomic_load(&g->components);
+        auto layout = atomic_load(&g->layout);
+        if (!index || index->graphVersion != g->version || (layout && layout->graphVersion == g->version)) {
+            rebuildIndexInBackground(g);
+        }
+    }
+    isModified = false;
+    return true;
+}
+
+namespace {
+// Per city sections hold one element per stored city, in the same order
+// IndexStore writes the names.
+template <typename T, typename Get>
+IndexStore::Section perCitySection(const string& tag, const vector<string>& cityNames, vector<T>& storage, Get get)
+{
+    storage.clear();
+    for (size_t id = 0; id < cityNames.size(); id++) {
+        if (!cityNames[id].empty()) storage.push_back(get(id));
+    }
+    IndexStore::Section section;
+    section.tag = tag;
+    section.elementSize = sizeof(T);
+    section.data = storage.data();
+    section.count = storage.size();
+    return section;
+}
+
+// Component labels, plus the cached layout when it belongs to this version.
+bool saveIndex(const string& path, const vector<string>& cityNames, uint64_t hash,
+               const Graph::ComponentIndex& index, const Graph::LayoutPositions* layout)
 {
-    f.setGraphs(graphs);
-    f.SaveInFile("C:\\Users\\Youssef Elshemy\\source\\repos\\wasalney_mini_Path_Finder\\filename.txt");
+    vector<int> labels;
+    vector<float> xs, ys;
+    vector<IndexStore::Section> sections;
+    sections.push_back(perCitySection("components", cityNames, labels, [&](size_t id) { return index.label[id]; }));
+    float size[2] = {0, 0};
+    if (layout) {
+        sections.push_back(perCitySection("layout_x", cityNames, xs, [&](size_t id) { return layout->x[id]; }));
+        sections.push_back(perCitySection("layout_y", cityNames, ys, [&](size_t id) { return layout->y[id]; }));
+        size[0] = layout->width;
+        size[1] = layout->height;
+        IndexStore::Section area;
+        area.tag = "layout_size";
+        area.elementSize = sizeof(float);
+        area.data = size;
+        area.count = 2;
+        sections.push_back(area);
+    }
+    string error;
+    return IndexStore::Save(path, cityNames, hash, sections, error);
+}
 
+// DIMACS .co positions fitted into the default layout area, north up, as
+// the graph's layout; nullptr unless every city has one.
+shared_ptr<Graph::LayoutPositions> coordinateLayout(const Graph& g, const vector<double>& cx,
+                                                    const vector<double>& cy)
+{
+    if (g.numberOfCities == 0 || cx.size() < (size_t)g.idCount() || cy.size() < (size_t)g.idCount()) return nullptr;
+    double minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+    for (int id = 0; id < g.idCount(); id++) {
+        if (!g.isCity(id)) continue;
+        if (isnan(cx[id]) || isnan(cy[id])) return nullptr;
+        minX = min(minX, cx[id]);
+        maxX = max(maxX, cx[id]);
+        minY = min(minY, cy[id]);
+        maxY = max(maxY, cy[id]);
+    }
+    LayoutOptions options;
+    double scale = min(maxX > minX ? (options.width - 2 * options.padding) / (maxX - minX) : INFINITY,
+                       maxY > minY ? (options.height - 2 * options.padding) / (maxY - minY) : INFINITY);
+    if (isinf(scale)) scale = 1;
+    const double centerX = (minX + maxX) / 2, centerY = (minY + maxY) / 2;
+
+    auto layout = make_shared<Graph::LayoutPositions>();
+    layout->graphVersion = g.version;
+    layout->width = (float)options.width;
+    layout->height = (float)options.height;
+    layout->x.assign(g.idCount(), NAN);
+    layout->y.assign(g.idCount(), NAN);
+    for (int id = 0; id < g.idCount(); id++) {
+        if (!g.isCity(id)) continue;
+        layout->x[id] = float((cx[id] - centerX) * scale + options.width / 2);
+        layout->y[id] = float((centerY - cy[id]) * scale + options.height / 2); // screen y grows down
+    }
+    layout->edgeSignature = GraphLayout::EdgeSignatures(g);
+    return layout;
+}
+}
+
+void Program::loadIndex(const shared_ptr<Graph>& g) {
+    TRACE_SPAN("Program::loadIndex");
+    IndexStore store;
+    auto index = make_shared<Graph::ComponentIndex>();
+    if (store.Open(IndexStore::SidecarPath(mapFile, g->name), *g)
+        && store.readPerCity<int>("components", index->label, -1)) {
+        for (int label : index->label) index->count = max(index->count, label + 1);
+        index->graphVersion = g->version;
+        atomic_store(&g->components, shared_ptr<const Graph::ComponentIndex>(index));
+
+        auto layout = make_shared<Graph::LayoutPositions>();
+        uint64_t count = 0;
+        const float* size = static_cast<const float*>(store.view("layout_size", sizeof(float), count));
+        if (size && count == 2 && store.readPerCity<float>("layout_x", layout->x, NAN)
+            && store.readPerCity<float>("layout_y", layout->y, NAN)) {
+            layout->graphVersion = g->version;
+            layout->width = size[0];
+            layout->height = size[1];
+            layout->edgeSignature = GraphLayout::EdgeSignatures(*g);
+            atomic_store(&g->layout, shared_ptr<const Graph::LayoutPositions>(layout));
+        }
+        return;
+    }
+    rebuildIndexInBackground(g);
+}
+
+void Program::storeLayout(const shared_ptr<Graph>& g, shared_ptr<const Graph::LayoutPositions> layout) {
+    if (!layout || layout->graphVersion != g->version) return;
+    atomic_store(&g->layout, std::move(layout));
+    if (!isModified) rebuildIndexInBackground(g);
+}
+
+void Program::rebuildIndexInBackground(const shared_ptr<Graph>& g) {
+    // The worker reads a snapshot, so the graph can keep changing on this
+    // thread while the index is built.
+    shared_ptr<const Graph> snap = snapshot(g);
+    if (!snap || snap->version != g->version) snap = g->snapshot();
+    string path = IndexStore::SidecarPath(mapFile, g->name);
+
+    pool.submit([this, g, snap, path]() {
+        TRACE_SPAN("Program::rebuildIndex");
+        const uint64_t version = snap->version;
+        shared_ptr<const Graph::ComponentIndex> index = atomic_load(&g->components);
+        if (!index || index->graphVersion != version) {
+            vector<int> offsets, targets;
+            snap->flatAdjacency(offsets, targets);
+            auto built = Graph::BuildComponentIndex(offsets, targets);
+            built->graphVersion = version;
+            index = built;
+            atomic_store(&g->components, index);
+        }
+        if (writeIndexes) {
+            vector<string> names(snap->cityNames.begin(), snap->cityNames.end());
+            uint64_t hash = snap->contentHash();
+            // Read the layout late, so a builder started before storeLayout()
+            // cannot overwrite the file without it.
+            lock_guard<mutex> lock(indexFileMutex);
+            auto layout = atomic_load(&g->layout);
+            saveIndex(path, names, hash, *index, layout && layout->graphVersion == version ? layout.get() : nullptr);
+        }
+    }, TaskPool::Background);
 }
 
 bool Program::addGraph(const string& name) {
     for (const auto& graph : graphs) {
-        if (graph.name == name) {
+        if (graph->name == name) {
             return false;
         }
     }
 
-    graphs.push_back(Graph());
-    graphs.back().name = name;
+    graphs.push_back(make_shared<Graph>());
+    graphs.back()->name = name;
+    publish(graphs.back());
 
     isModified = true;
     return true;
@@ -31,14 +199,14 @@ bool Program::addGraph(const string& name) {
 
 bool Program::deleteGraph(const string& name) {
 
-    auto it = find_if(graphs.begin(), graphs.end(), [&](const Graph& g) {
-        return g.name == name;
+    auto it = find_if(graphs.begin(), graphs.end(), [&](const shared_ptr<Graph>& g) {
+        return g->name == name;
     });
 
     if (it != graphs.end()) {
 
         if (currentGraph && currentGraph->name == name) {
-            currentGraph = nullptr;
+            currentGraph.reset();
         }
 
 
@@ -50,10 +218,91 @@ bool Program::deleteGraph(const string& name) {
     return false;
 }
 
-Graph* Program::getGraphByName(const string& name) {
+bool Program::importGraph(const string& path, string& error) {
+    size_t slash = path.find_last_of("/\\");
+    string base = path.substr(slash == string::npos ? 0 : slash + 1);
+    size_t dot = base.find_last_of('.');
+    string stem = base.substr(0, dot);
+    string extension = dot == string::npos ? "" : base.substr(dot);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (getGraphByName(stem)) {
+        error = "Graph name already exists. Use a unique name.";
+        return false;
+    }
+
+    auto graph = make_shared<Graph>();
+    graph->name = stem;
+    GraphImporter importer;
+    bool ok;
+    if (extension == ".gr") {
+        string prefix = path.substr(0, path.size() - extension.size());
+        string coPath = prefix + ".co", timePath = prefix + ".time.gr";
+        ifstream co(coPath), time(timePath);
+        ok = importer.ImportDimacs(path, *graph, time.good() ? timePath : "", co.good() ? coPath : "");
+    } else {
+        ok = importer.ImportEdgeList(path, *graph);
+    }
+    if (!ok) {
+        error = importer.lastError;
+        return false;
+    }
+
+    // The map's own positions spare a layout run.
+    if (auto layout = coordinateLayout(*graph, importer.coordX, importer.coordY)) {
+        atomic_store(&graph->layout, shared_ptr<const Graph::LayoutPositions>(layout));
+    }
+    graphs.push_back(graph);
+    publish(graph);
+    rebuildIndexInBackground(graph);
+    isModified = true;
+    return true;
+}
+
+bool Program::pasteEdges(const shared_ptr<Graph>& g, const string& text, string& error) {
+    GraphImporter importer;
+    if (!importer.ApplyEdgeList(text, *g)) {
+        error = importer.lastError;
+        return false;
+    }
+    publish(g);
+    isModified = true;
+    return true;
+}
+
+bool Program::commitEdit(const shared_ptr<Graph>& g) {
+    bool committed = g->commitTransaction();
+    publish(g); // commit bumps version even when nothing was logged
+    if (!committed) return false;
+    isModified = true;
+    return true;
+}
+
+bool Program::undo(const shared_ptr<Graph>& g) {
+    if (!g->undo()) return false;
+    publish(g);
+    isModified = true;
+    return true;
+}
+
+bool Program::redo(const shared_ptr<Graph>& g) {
+    if (!g->redo()) return false;
+    publish(g);
+    isModified = true;
+    return true;
+}
+
+void Program::publish(const shared_ptr<Graph>& g) {
+    if (g->inTransaction()) return;
+    auto current = snapshot(g);
+    if (current && current->version == g->version) return;
+    atomic_store(&g->published, g->snapshot());
+}
+
+shared_ptr<Graph> Program::getGraphByName(const string& name) {
     for (auto& g : graphs) {
-        if (g.name == name)
-            return &g;
+        if (g->name == name)
+            return g;
     }
     return nullptr;
 }
@@ -0,0 +1,205 @@
+#include "spatialindex.hpp"
+#include <algorithm>
+
+void SpatialIndex::build(const vector<float>& x, const vector<float>& y, const vector<int>& ids)
+{
+    clear();
+    float minX = 0, maxX = 0, minY = 0, maxY = 0;
+    bool first = true;
+    for (int id : ids) {
+        if (isnan(x[id]) || isnan(y[id])) continue;
+        minX = first ? x[id] : min(minX, x[id]);
+        maxX = first ? x[id] : max(maxX, x[id]);
+        minY = first ? y[id] : min(minY, y[id]);
+        maxY = first ? y[id] : max(maxY, y[id]);
+        first = false;
+    }
+    // About two cities per cell if they were spread evenly.
+    double area = max(1.0f, maxX - minX) * (double)max(1.0f, maxY - minY);
+    cellSize = (float)max(1.0, sqrt(2.0 * area / max<size_t>(1, ids.size())));
+    cells.reserve(ids.size());
+    for (int id : ids) update(id, x[id], y[id]);
+}
+
+void SpatialIndex::clear()
+{
+    xs.clear();
+    ys.clear();
+    slot.clear();
+    cells.clear();
+    count = 0;
+    minCellX = minCellY = 0;
+    maxCellX = maxCellY = -1;
+}
+
+const vector<int>* SpatialIndex::cell(int cx, int cy) const
+{
+    auto it = cells.find(key(cx, cy));
+    return it == cells.end() ? nullptr : &it->second;
+}
+
+void SpatialIndex::insert(int id, float x, float y)
+{
+    int cx = cellOf(x), cy = cellOf(y);
+    vector<int>& members = cells[key(cx, cy)];
+    slot[id] = (int)members.size();
+    members.push_back(id);
+    xs[id] = x;
+    ys[id] = y;
+    count++;
+    if (maxCellX < minCellX) {
+        minCellX = maxCellX = cx;
+        minCellY = maxCellY = cy;
+    } else {
+        minCellX = min(minCellX, cx);
+        maxCellX = max(maxCellX, cx);
+        minCellY = min(minCellY, cy);
+        maxCellY = max(maxCellY, cy);
+    }
+}
+
+void SpatialIndex::unlink(int id)
+{
+    auto it = cells.find(key(cellOf(xs[id]), cellOf(ys[id])));
+    vector<int>& members = it->second;
+    int last = members.back();
+    members[slot[id]] = last;
+    slot[last] = slot[id];
+    members.pop_back();
+    if (members.empty()) cells.erase(it);
+    slot[id] = -1;
+    count--;
+}
+
+void SpatialIndex::update(int id, float x, float y)
+{
+    if (id < 0) return;
+    if (isnan(x) || isnan(y)) {
+        remove(id);
+        return;
+    }
+    if (id >= (int)slot.size()) {
+        slot.resize(id + 1, -1);
+        xs.resize(id + 1, 0.0f);
+        ys.resize(id + 1, 0.0f);
+    }
+    if (slot[id] >= 0) {
+        if (cellOf(x) == cellOf(xs[id]) && cellOf(y) == cellOf(ys[id])) {
+            xs[id] = x;
+            ys[id] = y;
+            return;
+        }
+        unlink(id);
+    }
+    insert(id, x, y);
+}
+
+void SpatialIndex::remove(int id)
+{
+    if (contains(id)) unlink(id);
+}
+
+int SpatialIndex::nearest(float x, float y, float maxDistance) const
+{
+    if (count == 0 || isnan(x) || isnan(y)) return -1;
+    int best = -1;
+    float bestD2 = maxDistance * maxDistance;
+    const int cx = cellOf(x), cy = cellOf(y);
+    // Rings of cells around the query cell; every city in ring r is at least
+    // (r - 1) cells away. Nothing lies beyond the occupied cells.
+    int lastRing = max(max(abs(cx - minCellX), abs(cx - maxCellX)), max(abs(cy - minCellY), abs(cy - maxCellY)));
+    int firstRing = max(max(minCellX - cx, cx - maxCellX), max(minCellY - cy, cy - maxCellY));
+    auto scan = [&](int gx, int gy) {
+        if (gx < minCellX || gx > maxCellX || gy < minCellY || gy > maxCellY) return;
+        const vector<int>* members = cell(gx, gy);
+        if (!members) return;
+        for (int id : *members) {
+            float dx = xs[id] - x, dy = ys[id] - y;
+            float d2 = dx * dx + dy * dy;
+            if (d2 <= bestD2) {
+                best = id;
+                bestD2 = d2;
+            }
+        }
+    };
+    for (int r = max(0, firstRing); r <= lastRing; r++) {
+        float gap = (r - 1) * cellSize;
+        if (r > 0 && gap > 0 && gap * gap > bestD2) break;
+        if (r == 0) {
+            scan(cx, cy);
+            continue;
+        }
+        for (int d = -r; d <= r; d++) {
+            scan(cx + d, cy - r);
+            scan(cx + d, cy + r);
+        }
+        for (int d = -r + 1; d <= r - 1; d++) {
+            scan(cx - r, cy + d);
+            scan(cx + r, cy + d);
+        }
+    }
+    return best;
+}
+
+vector<int> SpatialIndex::inRect(float minX, float minY, float maxX, float maxY) const
+{
+    vector<int> found;
+    if (count == 0) return found;
+    int c0 = max(cellOf(minX), minCellX), c1 = min(cellOf(maxX), maxCellX);
+    int r0 = max(cellOf(minY), minCellY), r1 = min(cellOf(maxY), maxCellY);
+    // A huge rect is cheaper to answer by walking the cities.
+    if ((int64_t)(c1 - c0 + 1) * (r1 - r0 + 1) > (int64_t)cells.size()) {
+        for (const auto& entry : cells) {
+            for (int id : entry.second) {
+                if (xs[id] >= minX && xs[id] <= maxX && ys[id] >= minY && ys[id] <= maxY) found.push_back(id);
+            }
+        }
+        return found;
+    }
+    for (int gy = r0; gy <= r1; gy++) {
+        for (int gx = c0; gx <= c1; gx++) {
+            const vector<int>* members = cell(gx, gy);
+            if (!members) continue;
+            for (int id : *members) {
+                if (xs[id] >= minX && xs[id] <= maxX && ys[id] >= minY && ys[id] <= maxY) found.push_back(id);
+            }
+        }
+    }
+    return found;
+}
+
+vector<int> SpatialIndex::withinRadius(float x, float y, float radius) const
+{
+    vector<int> found = inRect(x - radius, y - radius, x + radius, y + radius);
+    found.erase(remove_if(found.begin(), found.end(), [&](int id) {
+        float dx = xs[id] - x, dy = ys[id] - y;
+        return dx * dx + dy * dy > radius * radius;
+    }), found.end());
+    return found;
+}
+
+vector<int> SpatialIndex::inPolygon(const vector<float>& px, const vector<float>& py) const
+{
+    const size_t n = min(px.size(), py.size());
+    if (n < 3) return {};
+    float minX = px[0], maxX = px[0], minY = py[0], maxY = py[0];
+    for (size_t i = 1; i < n; i++) {
+        minX = min(minX, px[i]);
+        maxX = max(maxX, px[i]);
+        minY = min(minY, py[i]);
+        maxY = max(maxY, py[i]);
+    }
+    vector<int> found = inRect(minX, minY, maxX, maxY);
+    // Even-odd rule: count polygon edges crossed by a ray to the right.
+    found.erase(remove_if(found.begin(), found.end(), [&](int id) {
+        bool inside = false;
+        for (size_t i = 0, j = n - 1; i < n; j = i++) {
+            if ((py[i] > ys[id]) != (py[j] > ys[id]) &&
+                xs[id] < (px[j] - px[i]) * (ys[id] - py[i]) / (py[j] - py[i]) + px[i]) {
+                inside = !inside;
+            }
+        }
+        return !inside;
+    }), found.end());
+    return found;
+}
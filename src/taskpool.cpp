@@ -0,0 +1,141 @@
+#include "taskpool.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace {
+// The pool and worker index of the calling thread, if it is a worker.
+thread_local const TaskPool* currentPool = nullptr;
+thread_local int currentWorker = -1;
+}
+
+TaskPool::TaskPool(unsigned threads)
+{
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    for (unsigned i = 0; i <= threads; i++) queues.push_back(make_unique<Queue>());
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([this, i]() { run((int)i); });
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        lock_guard<mutex> lock(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void TaskPool::submit(function<void()> task, Priority priority)
+{
+    Queue& queue = currentPool == this ? *queues[currentWorker] : *queues.back();
+    {
+        lock_guard<mutex> lock(queue.lock);
+        queue.tasks[priority].push_back(std::move(task));
+    }
+    // Counted after the push, so a worker woken for it finds it; the empty
+    // critical section orders the count before a sleeping worker's check.
+    queued++;
+    { lock_guard<mutex> lock(sleepLock); }
+    wake.notify_one();
+}
+
+void TaskPool::run(int self)
+{
+    currentPool = this;
+    currentWorker = self;
+    function<void()> task;
+    for (;;) {
+        if (take(self, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock<mutex> lock(sleepLock);
+        wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) return;
+    }
+}
+
+bool TaskPool::popFront(Queue& queue, int priority, function<void()>& task)
+{
+    lock_guard<mutex> lock(queue.lock);
+    auto& tasks = queue.tasks[priority];
+    if (tasks.empty()) return false;
+    task = std::move(tasks.front());
+    tasks.pop_front();
+    return true;
+}
+
+bool TaskPool::take(int self, function<void()>& task)
+{
+    const int n = (int)size();
+    for (int priority = 0; priority < PRIORITIES; priority++) {
+        bool found = false;
+        {
+            Queue& own = *queues[self];
+            lock_guard<mutex> lock(own.lock);
+            auto& tasks = own.tasks[priority];
+            if (!tasks.empty()) {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                found = true;
+            }
+        }
+        found = found || popFront(*queues[n], priority, task);
+        for (int i = 1; !found && i < n; i++) found = popFront(*queues[(self + i) % n], priority, task);
+        if (found) {
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::parallelFor(int begin, int end, const function<void(int, int)>& body,
+                           Priority priority, const CancelToken& token, int grain)
+{
+    if (begin >= end) return;
+    const long long length = (long long)end - begin;
+    if (grain <= 0) grain = (int)max<long long>(1, length / (4LL * size()));
+    const int chunks = (int)((length + grain - 1) / grain);
+
+    struct State {
+        atomic<int> next{0};
+        atomic<int> left{0};
+        atomic<bool> failed{false};
+        mutex lock;
+        condition_variable finished;
+        exception_ptr error;
+    };
+    auto state = make_shared<State>();
+    state->left = chunks;
+
+    // Helpers that start after every chunk was taken return without touching
+    // body, which lives only as long as this call.
+    auto work = [state, &body, token, begin, end, grain, chunks]() {
+        for (int c; (c = state->next++) < chunks;) {
+            if (!token.cancelled() && !state->failed.load()) {
+                int from = begin + c * grain;
+                try {
+                    body(from, (int)min<long long>(end, (long long)from + grain));
+                } catch (...) {
+                    lock_guard<mutex> lock(state->lock);
+                    if (!state->error) state->error = current_exception();
+                    state->failed = true;
+                }
+            }
+            if (--state->left == 0) {
+                lock_guard<mutex> lock(state->lock);
+                state->finished.notify_all();
+            }
+        }
+    };
+    for (int i = 0, helpers = min(chunks - 1, (int)size()); i < helpers; i++) submit(work, priority);
+    work();
+
+    unique_lock<mutex> lock(state->lock);
+    state->finished.wait(lock, [&]() { return state->left.load() == 0; });
+    if (state->error) rethrow_exception(state->error);
+}
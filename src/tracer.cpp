@@ -0,0 +1,128 @@
+#include "tracer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+atomic<bool> Tracer::enabled{false};
+
+namespace {
+struct Event {
+    const char* name;
+    uint64_t start, end;
+};
+
+// Events are appended by the owning thread only and published by the
+// release store of count, so Flush() can read a block while it fills.
+struct Block {
+    static const size_t SIZE = 4096;
+    Event events[SIZE];
+    atomic<size_t> count{0};
+    atomic<Block*> next{nullptr};
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    Block* first = new Block;
+    Block* last = first; // owning thread only
+};
+
+// Buffers outlive their threads, so spans of finished workers are still
+// written. Deliberately leaked: the exit flush may run after static
+// destructors.
+struct Registry {
+    mutex lock; // registration and Flush only, never per span
+    vector<unique_ptr<ThreadBuffer>> buffers;
+    string path;
+    uint64_t epoch = 0;
+    bool flushAtExit = false;
+};
+Registry& registry()
+{
+    static Registry* r = new Registry;
+    return *r;
+}
+
+thread_local ThreadBuffer* current = nullptr;
+
+void writeName(FILE* out, const char* name)
+{
+    for (const char* p = name; *p; p++) {
+        if (*p == '"' || *p == '\\') fputc('\\', out);
+        fputc(*p, out);
+    }
+}
+}
+
+void Tracer::Start(const string& path)
+{
+    Registry& r = registry();
+    {
+        lock_guard<mutex> lock(r.lock);
+        r.path = path;
+        if (!r.epoch) r.epoch = Now();
+        if (!r.flushAtExit) {
+            r.flushAtExit = true;
+            atexit([]() { Flush(); });
+        }
+    }
+    enabled.store(true);
+}
+
+bool Tracer::StartFromEnvironment()
+{
+    const char* path = getenv("WASALNEY_TRACE");
+    if (!path || !*path) return false;
+    Start(path);
+    return true;
+}
+
+void Tracer::Record(const char* name, uint64_t start, uint64_t end)
+{
+    if (!current) {
+        Registry& r = registry();
+        lock_guard<mutex> lock(r.lock);
+        r.buffers.push_back(make_unique<ThreadBuffer>());
+        current = r.buffers.back().get();
+        current->tid = (int)r.buffers.size();
+    }
+    Block* block = current->last;
+    size_t n = block->count.load(memory_order_relaxed);
+    if (n == Block::SIZE) {
+        Block* next = new Block;
+        block->next.store(next, memory_order_release);
+        current->last = block = next;
+        n = 0;
+    }
+    block->events[n] = {name, start, end};
+    block->count.store(n + 1, memory_order_release);
+}
+
+bool Tracer::Flush()
+{
+    Registry& r = registry();
+    lock_guard<mutex> lock(r.lock);
+    if (r.path.empty()) return false;
+    FILE* out = fopen(r.path.c_str(), "w");
+    if (!out) return false;
+
+    fprintf(out, "{\"traceEvents\":[");
+    bool first = true;
+    for (const auto& buffer : r.buffers) {
+        for (const Block* block = buffer->first; block; block = block->next.load(memory_order_acquire)) {
+            size_t n = block->count.load(memory_order_acquire);
+            for (size_t i = 0; i < n; i++) {
+                const Event& e = block->events[i];
+                double ts = e.start > r.epoch ? (e.start - r.epoch) / 1000.0 : 0.0;
+                fprintf(out, "%s\n{\"name\":\"", first ? "" : ",");
+                writeName(out, e.name);
+                fprintf(out, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        buffer->tid, ts, (e.end - e.start) / 1000.0);
+                first = false;
+            }
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(out) == 0;
+}
@@ -0,0 +1,11 @@
+# Builds everything: the core library, the command line tools, the map
+# generator, the benchmarks and the Qt app.
+# wasalney_mini.pro can still be opened on its own in Qt Creator.
+TEMPLATE = subdirs
+
+SUBDIRS += core cli mapgen bench app
+
+cli.depends = core
+mapgen.depends = core
+bench.depends = core
+app.file = wasalney_mini.pro
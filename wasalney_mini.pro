@@ -1,25 +1,28 @@
 QT       += core gui
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG += c++17
+CONFIG += c++20
 
 INCLUDEPATH += include
 
+include(core/core.pri)
+
 SOURCES += \
      src/mainform.cpp \
     src/editgraph.cpp \
-    src/program.cpp \
-    src/filehandler.cpp \
-    src/graph.cpp \
     src/main.cpp \
     src/mainwindow.cpp \
-    src/exploremap.cpp
+    src/exploremap.cpp \
+    src/graphviewitems.cpp \
+    src/mapscene.cpp \
+    src/citylistmodel.cpp
 
 HEADERS += \
-    include/program.hpp \
-    include/filehandler.hpp \
-    include/graph.hpp \
     include/graphviewitems.hpp \
+    include/mapscene.h \
+    include/citylistmodel.h \
+    include/cityname.h \
+    include/guitask.h \
     include/mainwindow.h \
     include/exploremap.h \
     include/mainform.h \